@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "Wire.h"
+#include <i2c_fifo.h>
+#include <i2c_regmap.h>
+#include <i2c_slave.h>
+#include <i2c_slave.hpp>
+#include <hardware/clocks.h>
+#include <pico/stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if !I2C_SLAVE_PROFILE
+#error "I2C_SLAVE_PROFILE must be enabled for the benchmark"
+#endif
+
+static const uint I2C_SLAVE_ADDRESS = 0x17;
+
+// As with the examples, master and slave run from the same board.
+// You'll need to wire pin GP4 to GP6 (SDA), and pin GP5 to GP7 (SCL). For 1 MHz, add external
+// pull-up resistors (around 1 kOhm), the internal ones are too weak.
+static const uint I2C_SLAVE_SDA_PIN = PICO_DEFAULT_I2C_SDA_PIN; // 4
+static const uint I2C_SLAVE_SCL_PIN = PICO_DEFAULT_I2C_SCL_PIN; // 5
+static const uint I2C_MASTER_SDA_PIN = 6;
+static const uint I2C_MASTER_SCL_PIN = 7;
+
+static const uint BAUDRATES[] = {100000, 400000, 1000000};
+static const size_t SIZES[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+static const size_t MAX_SIZE = 256;
+// payload bytes per data point and direction, so each point takes roughly the same time
+static const size_t BYTES_PER_POINT = 2048;
+static const size_t MIN_ITERATIONS = 8;
+
+// Each slave implements the same 256 byte memory as example_mem. Writes start with the memory
+// address, and reads continue from the current address.
+static struct
+{
+    uint8_t mem[MAX_SIZE];
+    uint8_t mem_address;
+    bool mem_address_written;
+} context;
+
+static uint current_baudrate;
+
+static i2c_slave_config_t bench_slave_config() {
+    return current_baudrate >= 1000000 ? i2c_slave_get_fast_mode_plus_config() : i2c_slave_get_default_config();
+}
+
+//
+// raw i2c_slave handler
+//
+
+static inline void mem_receive(i2c_inst_t *i2c) {
+    for (size_t n = i2c_get_read_available(i2c); n > 0; n--) {
+        uint8_t value = i2c_read_byte(i2c);
+        if (!context.mem_address_written) {
+            context.mem_address = value;
+            context.mem_address_written = true;
+        } else {
+            context.mem[context.mem_address++] = value;
+        }
+    }
+}
+
+static inline void mem_request(i2c_inst_t *i2c) {
+    i2c_write_byte(i2c, context.mem[context.mem_address++]);
+}
+
+static inline void mem_finish() {
+    context.mem_address_written = false;
+}
+
+static void I2C_SLAVE_HOT_FUNC(raw_handler)(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    switch (event) {
+    case I2C_SLAVE_RECEIVE:
+        mem_receive(i2c);
+        break;
+    case I2C_SLAVE_REQUEST:
+        mem_request(i2c);
+        break;
+    case I2C_SLAVE_FINISH:
+        mem_finish();
+        break;
+    default:
+        break;
+    }
+}
+
+static void setup_raw() {
+    context.mem_address_written = false;
+    i2c_slave_config_t config = bench_slave_config();
+    i2c_slave_init_with_config(i2c0, I2C_SLAVE_ADDRESS, &raw_handler, &config);
+}
+
+static void teardown_raw() {
+    i2c_slave_deinit(i2c0);
+}
+
+//
+// compile-time handler, same as raw but inlined into the ISR
+//
+
+struct TemplateHandler
+{
+    static void onReceive(i2c_inst_t *i2c) {
+        mem_receive(i2c);
+    }
+
+    static void onRequest(i2c_inst_t *i2c) {
+        mem_request(i2c);
+    }
+
+    static void onFinish(i2c_inst_t *i2c) {
+        mem_finish();
+    }
+};
+
+using TemplateSlave = I2cSlave<0, TemplateHandler>;
+
+I2C_SLAVE_DEFINE_IRQ_HANDLER(0, TemplateHandler)
+
+static void setup_template() {
+    context.mem_address_written = false;
+    TemplateSlave::init(I2C_SLAVE_ADDRESS, bench_slave_config());
+}
+
+static void teardown_template() {
+    TemplateSlave::deinit();
+}
+
+//
+// register map
+//
+
+static i2c_regmap_t regmap;
+
+static void setup_regmap() {
+    i2c_regmap_config_t config = i2c_regmap_get_default_config(context.mem, sizeof(context.mem));
+    i2c_regmap_init(&regmap, &config);
+    i2c_slave_config_t slave_config = bench_slave_config();
+    i2c_regmap_slave_init_with_config(i2c0, I2C_SLAVE_ADDRESS, &regmap, &slave_config);
+}
+
+static void teardown_regmap() {
+    i2c_slave_deinit(i2c0);
+}
+
+// same, with the first bytes of each read staged at the Restart
+static void setup_regmap_prefill() {
+    i2c_regmap_config_t config = i2c_regmap_get_default_config(context.mem, sizeof(context.mem));
+    config.prefill = true;
+    i2c_regmap_init(&regmap, &config);
+    i2c_slave_config_t slave_config = bench_slave_config();
+    i2c_regmap_slave_init_with_config(i2c0, I2C_SLAVE_ADDRESS, &regmap, &slave_config);
+}
+
+//
+// Wire
+//
+
+// Room for the memory address followed by a whole memory write, and for copying a response of the
+// whole memory. With the default TxSize of 32, the first write below would be sent from memory,
+// and the wrapped part of the response dropped.
+using BenchWire = BasicTwoWire<1 + MAX_SIZE, MAX_SIZE>;
+WIRE_DEFINE_INSTANCE(BenchWire, wire, i2c0)
+
+static void wire_on_receive(int count) {
+    context.mem_address = (uint8_t)wire.read();
+    while (wire.available()) {
+        context.mem[context.mem_address++] = (uint8_t)wire.read();
+    }
+}
+
+static void wire_on_request() {
+    // queue the rest of the memory, master reads as much as it needs
+    uint8_t address = context.mem_address;
+    wire.write(context.mem + address, MAX_SIZE - address);
+    wire.write(context.mem, address);
+}
+
+static void setup_wire() {
+    wire.onReceive(wire_on_receive);
+    wire.onRequest(wire_on_request);
+    if (current_baudrate >= 1000000) {
+        wire.begin(I2C_SLAVE_ADDRESS, i2c_slave_get_fast_mode_plus_config());
+    } else {
+        wire.begin(I2C_SLAVE_ADDRESS);
+    }
+}
+
+static void teardown_wire() {
+    wire.begin(); // back to master mode
+}
+
+//
+// benchmark
+//
+
+struct BenchPath
+{
+    const char *name;
+    void (*setup)();
+    void (*teardown)();
+    bool profiled; // runs from the C ISR, which keeps the profile
+};
+
+static const BenchPath PATHS[] = {
+    {"raw", &setup_raw, &teardown_raw, true},
+    {"template", &setup_template, &teardown_template, false},
+    {"regmap", &setup_regmap, &teardown_regmap, true},
+    {"regmap_prefill", &setup_regmap_prefill, &teardown_regmap, true},
+    {"wire", &setup_wire, &teardown_wire, true},
+};
+
+struct Latency
+{
+    uint64_t total_us;
+    uint32_t max_us;
+
+    void add(uint32_t us) {
+        total_us += us;
+        max_us = MAX(max_us, us);
+    }
+};
+
+static void fill_pattern(uint8_t *buf, size_t size, uint seed) {
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)(seed * 31 + i * 7);
+    }
+}
+
+static void run_point(const BenchPath &path, uint baudrate, size_t size) {
+    size_t iterations = MAX(MIN_ITERATIONS, BYTES_PER_POINT / size);
+    uint8_t out[1 + MAX_SIZE];
+    uint8_t in[MAX_SIZE];
+    uint errors = 0;
+    Latency write_latency = {};
+    Latency read_latency = {};
+
+    i2c_slave_reset_profile(i2c0);
+    uint64_t start_us = time_us_64();
+    for (size_t i = 0; i < iterations; i++) {
+        // always start from memory address 0, so 256 byte transfers don't wrap
+        out[0] = 0;
+        fill_pattern(out + 1, size, i);
+        uint32_t t0 = time_us_32();
+        int count = i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, 1 + size, false);
+        uint32_t t1 = time_us_32();
+        count += i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, 1, true);
+        count += i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, in, size, false);
+        uint32_t t2 = time_us_32();
+        write_latency.add(t1 - t0);
+        read_latency.add(t2 - t1);
+        if (count != (int)(2 + 2 * size) || memcmp(in, out + 1, size) != 0) {
+            errors++;
+        }
+    }
+    uint64_t elapsed_us = time_us_64() - start_us;
+
+    double bytes_per_s_write = 1e6 * size * iterations / (double)write_latency.total_us;
+    double bytes_per_s_read = 1e6 * size * iterations / (double)read_latency.total_us;
+
+    printf("%s,%u,%u,%u,%u,%.0f,%.0f,%.1f,%u,%.1f,%u,",
+        path.name, baudrate, (uint)size, (uint)iterations, errors,
+        bytes_per_s_write, bytes_per_s_read,
+        (double)write_latency.total_us / iterations, (uint)write_latency.max_us,
+        (double)read_latency.total_us / iterations, (uint)read_latency.max_us);
+    if (!path.profiled) {
+        puts(","); // no profile, rather than zeros
+        return;
+    }
+    i2c_slave_profile_t profile;
+    i2c_slave_get_profile(i2c0, &profile);
+    double cycles_per_us = clock_get_hz(clk_sys) / 1e6;
+    double response_us = profile.rd_req_response.total / cycles_per_us;
+    double isr_share = 100.0 * profile.isr.total / (elapsed_us * cycles_per_us);
+    printf("%.1f,%.2f\n", response_us, isr_share);
+}
+
+static void setup_pins() {
+    gpio_init(I2C_SLAVE_SDA_PIN);
+    gpio_set_function(I2C_SLAVE_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SLAVE_SDA_PIN);
+
+    gpio_init(I2C_SLAVE_SCL_PIN);
+    gpio_set_function(I2C_SLAVE_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SLAVE_SCL_PIN);
+
+    gpio_init(I2C_MASTER_SDA_PIN);
+    gpio_set_function(I2C_MASTER_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_MASTER_SDA_PIN);
+
+    gpio_init(I2C_MASTER_SCL_PIN);
+    gpio_set_function(I2C_MASTER_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_MASTER_SCL_PIN);
+}
+
+int main() {
+    stdio_init_all();
+    // give the host some time to open the serial connection
+    sleep_ms(2000);
+    puts("\nI2C slave benchmark");
+
+    setup_pins();
+    // One line per data point. Throughput counts payload bytes only, latencies are per
+    // transaction (a read includes setting the memory address), and rd_req_response_us is the
+    // total ISR time from entry on RD_REQ to the first byte in the Tx FIFO, for the data point.
+    // Clock stretching lasts longer, by the interrupt latency. rd_req_response_us and ISR load
+    // come from the C ISR, so they're left empty for the template path.
+    puts("# path,baudrate,size,iterations,errors,write_bytes_per_s,read_bytes_per_s,"
+         "write_us_avg,write_us_max,read_us_avg,read_us_max,rd_req_response_us,isr_cpu_percent");
+
+    for (const BenchPath &path : PATHS) {
+        for (uint baudrate : BAUDRATES) {
+            // i2c_init() resets the I2C block, so the slave is set up again for each baudrate
+            i2c_init(i2c0, baudrate);
+            i2c_init(i2c1, baudrate);
+            current_baudrate = baudrate;
+            path.setup();
+            for (size_t size : SIZES) {
+                run_point(path, baudrate, size);
+            }
+            path.teardown();
+        }
+    }
+    puts("# done");
+}
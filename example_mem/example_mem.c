@@ -32,7 +32,8 @@ static struct
 } context;
 
 // Our handler is called from the I2C ISR, so it must complete quickly. Blocking calls /
-// printing to stdio may interfere with interrupt handling.
+// printing to stdio may interfere with interrupt handling. To see what goes on in the ISR, build
+// with I2C_SLAVE_TRACE=1 and dump the trace later, see i2c_slave_trace_dump().
 static void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
     switch (event) {
     case I2C_SLAVE_RECEIVE: // master has written some data
@@ -8,6 +8,13 @@
 #define _WIRE_H_
 
 #include <i2c_slave.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
+#include <stdint.h>
+#include <string.h>
+#include <array>
+#include <type_traits>
 
 /** \file Wire.h
  *
@@ -20,33 +27,109 @@
 
 /**
  * \brief Called in slave mode after receiving data from master.
- * 
+ *
  * The received data is buffered internally, and the handler is called once the transfer has
- * completed (after the master sends a Stop or Start signal).
- * 
- * The maximum transfer size is determined by WIRE_BUFFER_LENGTH. Because of how the I2C
+ * completed (after the master sends a Stop or Start signal). By default it runs from the I2C ISR,
+ * see `BasicTwoWire::deferReceive()` for running it from thread context.
+ *
+ * The maximum transfer size is determined by the receive buffer size. Because of how the I2C
  * hardware operates on RP2040, there is no way to NACK once the buffer is full, so excess
  * data is simply discarded.
- * 
+ *
  * \param count The number of bytes available for reading.
  */
 using WireReceiveHandler = void (*)(int count);
 
+/**
+ * \brief Called in slave mode when data has been received, with the data itself.
+ *
+ * Same as `WireReceiveHandler`, except the received bytes are passed in place, so they can be
+ * parsed without calling `BasicTwoWire::read()` for each. `data` points into the receive buffer
+ * (or the deferred receive queue), and is only valid until the handler returns.
+ *
+ * \param data Received bytes.
+ * \param len Number of bytes received.
+ */
+using WireReceiveSpanHandler = void (*)(const uint8_t *data, size_t len);
+
 /**
  * \brief Called in slave mode when the master is requesting data.
+ *
+ * Runs from the I2C ISR. The response written with `BasicTwoWire::write()` is queued, and sent
+ * from the ISR as master reads it, so the handler returns right away. The handler is called
+ * again if master keeps reading after the whole response was sent, except with SMBus PEC, where
+ * the response is followed by its PEC byte instead.
  */
 using WireRequestHandler = void (*)();
 
 /**
- * \brief Wire API wrapper.
+ * \brief Called in master mode when an asynchronous transfer has completed.
+ *
+ * Runs from the I2C ISR of the master instance, on the core which started the transfer. It may
+ * start the next transfer.
+ *
+ * \param result 0 on success.
+ *               2 if the slave address was NACKed.
+ *               3 if data was NACKed.
+ *               4 on other error.
  */
-class TwoWire final
+using WireCompletionHandler = void (*)(uint8_t result);
+
+/**
+ * \brief Wire API wrapper, with custom buffer sizes.
+ *
+ * Index types are sized to the buffers, so transfers may exceed 255 bytes.
+ *
+ * \tparam RxSize Receive buffer size, for `requestFrom()` in master mode, and for data written by
+ *                master in slave mode.
+ * \tparam TxSize Transmit buffer size, for `beginTransmission()` ... `endTransmission()` in
+ *                master mode, and for the response to each request in slave mode.
+ * \tparam RxQueueLength Number of received transfers queued with `deferReceive()`, each in a
+ *                       buffer of RxSize bytes. Must be a power of two, up to 128. The default of
+ *                       0 leaves out the queue, and deferred receive with it.
+ * \tparam AsyncMaster Whether to support `endTransmissionAsync()` and `requestFromAsync()`,
+ *                     which need a buffer of 16-bit DMA command words for the larger of RxSize
+ *                     and TxSize.
+ *
+ * Slave responses may be longer than TxSize. Once the buffer is full, the rest of the data passed
+ * to `write()` is sent straight from the caller's memory, see `write()`.
+ */
+template <size_t RxSize = WIRE_BUFFER_LENGTH, size_t TxSize = RxSize, size_t RxQueueLength = 0,
+    bool AsyncMaster = false>
+class BasicTwoWire final
 {
+    static_assert(RxSize > 0 && TxSize > 0, "buffers must not be empty");
+    static_assert(RxQueueLength <= 128 && (RxQueueLength & (RxQueueLength - 1)) == 0,
+        "RxQueueLength must be 0 or a power of two, up to 128");
+
 public:
     /**
-     * \brief Don't call, use the global Wire and Wire1 instances instead.
+     * \brief Receive buffer size.
+     */
+    static constexpr size_t RX_BUFFER_LENGTH = RxSize;
+
+    /**
+     * \brief Transmit buffer size.
      */
-    TwoWire();
+    static constexpr size_t TX_BUFFER_LENGTH = TxSize;
+
+    /**
+     * \brief Create a Wire instance for an I2C instance.
+     *
+     * Only one Wire instance should be active on each I2C instance at a time. For the default
+     * buffer sizes, use the global Wire and Wire1 instances.
+     *
+     * Define instances with `WIRE_DEFINE_INSTANCE()`, which passes ISR entry points on the slave
+     * hot path. Without them, the ISR path runs from flash: GCC ignores section attributes on
+     * template members, so they can't be placed in RAM themselves.
+     *
+     * \param i2c I2C instance (i2c0 or i2c1).
+     * \param slaveHandler Slave event handler, calling `handleSlaveEvent()`. May be null.
+     * \param masterIrqHandler I2C interrupt handler for asynchronous master transfers, calling
+     *                         `serviceAsync()`. May be null.
+     */
+    explicit BasicTwoWire(i2c_inst_t *i2c, i2c_slave_handler_t slaveHandler = nullptr,
+        irq_handler_t masterIrqHandler = nullptr);
 
     /**
      * \brief Get the associated I2C instance (i2c0 or i2c1).
@@ -55,7 +138,7 @@ public:
 
     /**
      * \brief Initialize in master mode.
-     * 
+     *
      * Note: The Wire library typically initializes predefined I2C pins and enables internal
      *       pull-up resistors here. In this implementation, the user is responsible for setting
      *       up the I2C instance and GPIO pins in advance.
@@ -64,7 +147,7 @@ public:
 
     /**
      * \brief Initialize in slave mode.
-     * 
+     *
      * Note: The Wire library typically initializes predefined I2C pins and enables internal
      *       pull-up resistors here. In this implementation, the user is responsible for setting
      *       up the I2C instance and GPIO pins in advance.
@@ -73,26 +156,38 @@ public:
      */
     void begin(uint8_t selfAddress);
 
+    /**
+     * \brief Initialize in slave mode, with custom settings.
+     *
+     * For example, raising the Rx threshold in `config` batches received data, so that slave
+     * writes cause fewer interrupts. Streaming transmit is always enabled, since it's used to
+     * send queued responses. The default configuration refills the Tx FIFO once it's half empty.
+     *
+     * \param selfAddress Slave address.
+     * \param config Slave configuration.
+     */
+    void begin(uint8_t selfAddress, const i2c_slave_config_t &config);
+
     /**
      * \brief Begin writing to a slave.
-     * 
+     *
      * Available in master mode.
-     * 
-     * The maximum transfer size is determined by WIRE_BUFFER_LENGTH. Excess data will be ignored.
-     * 
+     *
+     * The maximum transfer size is determined by TxSize. Excess data will be ignored.
+     *
      * \param address Slave address.
      */
     void beginTransmission(uint8_t address);
 
     /**
      * \brief Finish writing to the slave.
-     * 
+     *
      * Available in master mode.
-     * 
+     *
      * Flushes the write buffer and blocks until completion.
-     * 
+     *
      * \param sendStop Whether to send Stop signal at the end.
-     * \return 0 on success. 
+     * \return 0 on success.
      *         3 if transfer was interrupted by the slave via NACK.
      *         4 on other error.
      */
@@ -100,16 +195,60 @@ public:
 
     /**
      * \brief Read data from a slave.
-     * 
+     *
      * Available in master mode.
-     * 
+     *
      * \param address Slave address.
-     * \param count Amount of data to read.
+     * \param count Amount of data to read, up to RxSize.
      * \param sendStop Whether to send Stop signal at the end.
      * \return 0 on error.
      *         `count` on success.
      */
-    uint8_t requestFrom(uint8_t address, size_t count, bool sendStop);
+    size_t requestFrom(uint8_t address, size_t count, bool sendStop);
+
+    /**
+     * \brief Finish writing to the slave, without blocking.
+     *
+     * Available in master mode, with AsyncMaster.
+     *
+     * Starts sending the write buffer using DMA, and returns immediately. On completion,
+     * `handler` is called from the I2C ISR, and `busy()` goes back to false. The write buffer may
+     * be reused as soon as this returns.
+     *
+     * The first asynchronous transfer claims two DMA channels and the I2C interrupt on the calling
+     * core, which are kept until the next `begin()`.
+     *
+     * \param sendStop Whether to send Stop signal at the end.
+     * \param handler Completion handler, may be null.
+     */
+    void endTransmissionAsync(bool sendStop = true, WireCompletionHandler handler = nullptr);
+
+    /**
+     * \brief Read data from a slave, without blocking.
+     *
+     * Available in master mode, with AsyncMaster.
+     *
+     * Starts a DMA transfer into the read buffer, and returns immediately. On completion,
+     * `handler` is called from the I2C ISR, and the data is available for reading.
+     *
+     * \param address Slave address.
+     * \param count Amount of data to read, between 1 and RxSize.
+     * \param sendStop Whether to send Stop signal at the end.
+     * \param handler Completion handler, may be null.
+     */
+    void requestFromAsync(uint8_t address, size_t count, bool sendStop, WireCompletionHandler handler = nullptr);
+
+    /**
+     * \brief Check if an asynchronous transfer is in progress.
+     */
+    bool busy() const;
+
+    /**
+     * \brief Get the result of the last asynchronous transfer.
+     *
+     * \return Same as WireCompletionHandler.
+     */
+    uint8_t result() const;
 
     /**
      * \brief Get the amount of data in the read buffer.
@@ -118,51 +257,123 @@ public:
 
     /**
      * \brief Get the next byte from the read buffer without removing it.
-     * 
+     *
      * \return the buffer value, or -1 if the read buffer is empty.
      */
     int peek() const;
 
     /**
      * \brief Get the next byte from the read buffer.
-     * 
+     *
      * \return the buffer value, or -1 if the read buffer is empty.
      */
     int read();
 
     /**
      * \brief Write a single byte.
-     * 
+     *
+     * In slave mode, data is queued for sending and this returns immediately. It should only be
+     * called from the request handler. Single bytes are always copied, so they're dropped once the
+     * TxSize buffer is full.
+     *
      * \param value Byte value.
      * \return 1 on success.
-     *         0 if the buffer is full (when transmitting in master mode).
+     *         0 if the buffer is full.
      */
     size_t write(uint8_t value);
 
     /**
      * \brief Write data.
-     * 
+     *
+     * In slave mode, data is queued for sending and this returns immediately. It should only be
+     * called from the request handler. Whatever doesn't fit in the TxSize buffer is sent straight
+     * from `data`, which must then stay valid until the transfer ends (so not on the handler's
+     * stack). Only one write per response can do this, later ones return 0.
+     *
      * \param data Data pointer.
      * \param size Data size.
-     * \return The amount of data written. May be less than len if the buffer fills up (when
-     *         transmitting in master mode).
+     * \return The amount of data written. May be less than len if the buffer fills up.
      */
     size_t write(const uint8_t *data, size_t size);
 
     /**
      * \brief Set the receive handler for slave mode.
-     * 
+     *
      * \param handler Receive handler.
      */
     void onReceive(WireReceiveHandler handler);
 
+    /**
+     * \brief Set the receive handler for slave mode, taking the received data in place.
+     *
+     * Replaces any handler set with `onReceive(WireReceiveHandler)`.
+     *
+     * \param handler Receive handler.
+     */
+    void onReceive(WireReceiveSpanHandler handler);
+
     /**
      * \brief Set the request handler for slave mode.
-     * 
+     *
      * \param handler Request handler.
      */
     void onRequest(WireRequestHandler handler);
 
+    /**
+     * \brief Run the receive handler from `poll()` instead of the I2C ISR.
+     *
+     * Available in slave mode, with RxQueueLength > 0. Should be called before `begin()`.
+     *
+     * Received transfers are queued in RxQueueLength buffers of RxSize bytes, so the master can
+     * keep writing while the handler is busy. Transfers arriving when the queue is full are
+     * discarded.
+     *
+     * \param defer Whether to defer the receive handler.
+     */
+    void deferReceive(bool defer = true);
+
+    /**
+     * \brief Run the receive handler for each queued transfer.
+     *
+     * Available in slave mode, with deferred receive. May be called from either core, for example
+     * from a loop on core1. The ISR signals an event (see `__wfe()`) whenever a new transfer is
+     * queued.
+     *
+     * \return The number of transfers handled.
+     */
+    size_t poll();
+
+    /**
+     * \brief Get the number of received bytes discarded in slave mode.
+     *
+     * Counts data that didn't fit in RxSize, and transfers that didn't fit in the receive queue.
+     * May be read from thread context while the slave is running. See `i2c_slave_get_stats()`
+     * for lower level statistics.
+     */
+    uint32_t discarded() const;
+
+    /**
+     * \brief Check the SMBus PEC of the received transfer.
+     *
+     * Available in slave mode, when begun with `i2c_slave_config_t::pec` enabled. Call from the
+     * receive handler, where the last received byte is the PEC byte. PEC is accumulated while the
+     * data is drained from the Rx FIFO, so there is no second pass over the buffer. Responses get
+     * their PEC byte appended automatically. Not available with deferred receive.
+     */
+    bool pecValid() const;
+
+    /**
+     * \brief Handle a slave event. Inlined into the entry points of `WIRE_DEFINE_INSTANCE()`, not
+     * meant to be called otherwise.
+     */
+    __force_inline void handleSlaveEvent(i2c_inst_t *i2c, i2c_slave_event_t event);
+
+    /**
+     * \brief Serve the I2C interrupt of an asynchronous master transfer. Inlined into the entry
+     * points of `WIRE_DEFINE_INSTANCE()`, not meant to be called otherwise.
+     */
+    __force_inline void serviceAsync();
+
 private:
     static constexpr uint8_t NO_ADDRESS = 255;
 
@@ -173,21 +384,96 @@ private:
         Slave,
     };
 
-    TwoWire(const TwoWire &other) = delete; // not copyable
+    // smallest unsigned type that can index a buffer of size N
+    template <size_t N>
+    using IndexFor = std::conditional_t<N <= UINT8_MAX, uint8_t, std::conditional_t<N <= UINT16_MAX, uint16_t, uint32_t>>;
+
+    using RxIndex = IndexFor<RxSize>;
+    using TxIndex = IndexFor<TxSize>;
+
+    struct RxSlot
+    {
+        uint8_t data[RxSize];
+        RxIndex len;
+    };
+
+    BasicTwoWire(const BasicTwoWire &other) = delete; // not copyable
+
+    BasicTwoWire &operator=(const BasicTwoWire &other) = delete; // not copyable
+
+    // entry points for instances created without WIRE_DEFINE_INSTANCE(), in flash
+    static void handleSlaveEventFallback(i2c_inst_t *i2c, i2c_slave_event_t event);
+
+    template <uint Index>
+    static void handleIrqFallback();
+
+    __force_inline void handleReceive(i2c_inst_t *i2c);
+
+    __force_inline void handleRequest(i2c_inst_t *i2c);
+
+    __force_inline void handleFinish();
+
+    __force_inline void receiveDeferred(i2c_inst_t *i2c);
+
+    __force_inline void finishDeferred();
+
+    __force_inline void discardReceived(i2c_inst_t *i2c);
+
+    __force_inline void sendQueued(i2c_inst_t *i2c);
+
+    irq_handler_t masterIrqHandler() const;
 
-    TwoWire &operator=(const TwoWire &other) = delete; // not copyable
+    void startAsync(uint8_t address, bool read, size_t count, bool sendStop, WireCompletionHandler handler);
 
-    static void handleEvent(i2c_inst_t *i2c, i2c_slave_event_t event);
+    __force_inline void finishAsync(uint8_t result);
 
+    void endAsync();
+
+    // active instances, for the fallback entry points
+    static inline BasicTwoWire *instances_[2] = {};
+
+    i2c_inst_t *const i2c_;
+    const i2c_slave_handler_t slaveHandler_;
+    const irq_handler_t masterIrqHandler_;
     WireReceiveHandler receiveHandler_ = nullptr;
+    WireReceiveSpanHandler receiveSpanHandler_ = nullptr;
     WireRequestHandler requestHandler_ = nullptr;
     Mode mode_ = Unassigned;
-    uint8_t txAddress_ = 255;
-    uint8_t buf_[WIRE_BUFFER_LENGTH];
-    uint8_t bufLen_ = 0;
-    uint8_t bufPos_ = 0;
+    uint8_t txAddress_ = NO_ADDRESS;
+    uint8_t rxBuf_[RxSize];
+    RxIndex rxLen_ = 0;
+    RxIndex rxPos_ = 0;
+    uint8_t txBuf_[TxSize];
+    TxIndex txLen_ = 0;
+    TxIndex txPos_ = 0; // next byte to send in slave mode
+    const uint8_t *txMore_ = nullptr; // rest of the response, in caller memory
+    size_t txMoreLen_ = 0;
+    bool deferReceive_ = false;
+    bool pec_ = false; // slave appends PEC to responses
+    std::array<RxSlot, RxQueueLength> rxQueue_; // for deferReceive(), empty by default
+    volatile uint8_t rxHead_ = 0; // written by ISR
+    volatile uint8_t rxTail_ = 0; // written by poll()
+    RxIndex rxFill_ = 0; // bytes received into rxQueue_[rxHead_]
+    bool rxDiscarding_ = false; // no room for the current transfer
+    volatile uint32_t discarded_ = 0; // written by ISR
+    // IC_DATA_CMD words for DMA master transfers, empty by default
+    std::array<uint16_t, AsyncMaster ? (RxSize > TxSize ? RxSize : TxSize) : 0> cmdBuf_;
+    WireCompletionHandler completionHandler_ = nullptr;
+    bool asyncEnabled_ = false; // DMA channels claimed, and I2C interrupt enabled
+    bool asyncRead_ = false;
+    bool asyncStop_ = false;
+    size_t asyncLen_ = 0;
+    uint asyncTxChannel_ = 0;
+    uint asyncRxChannel_ = 0;
+    volatile bool asyncBusy_ = false; // written by ISR
+    volatile uint8_t asyncResult_ = 0; // written by ISR
 };
 
+/**
+ * \brief Wire API wrapper, with the default buffer size (WIRE_BUFFER_LENGTH).
+ */
+using TwoWire = BasicTwoWire<>;
+
 /**
  * \brief Wire instance for i2c0
  */
@@ -198,29 +484,589 @@ extern TwoWire Wire;
  */
 extern TwoWire Wire1;
 
+extern template class BasicTwoWire<>;
+
+/**
+ * \brief Define a Wire instance, with its ISR entry points on the slave hot path.
+ *
+ * Use at namespace scope, in a source file. The instance goes alongside the entry points, see
+ * `I2C_SLAVE_HOT_DATA()`. For example:
+ *
+ *     using BigWire = BasicTwoWire<32, 256>;
+ *     WIRE_DEFINE_INSTANCE(BigWire, bigWire, i2c0)
+ *
+ * \param Type A `BasicTwoWire` type.
+ * \param name Instance name.
+ * \param i2c I2C instance (i2c0 or i2c1).
+ */
+#define WIRE_DEFINE_INSTANCE(Type, name, i2c)                                                    \
+    static void name##_slave_handler(i2c_inst_t *, i2c_slave_event_t);                          \
+    static void name##_master_irq_handler();                                                     \
+    I2C_SLAVE_HOT_DATA("Wire") Type name(i2c, &name##_slave_handler, &name##_master_irq_handler); \
+    static void I2C_SLAVE_HOT("Wire") name##_slave_handler(i2c_inst_t *i2c_, i2c_slave_event_t event) { \
+        name.handleSlaveEvent(i2c_, event);                                                      \
+    }                                                                                            \
+    static void I2C_SLAVE_HOT("Wire") name##_master_irq_handler() {                              \
+        name.serviceAsync();                                                                     \
+    }
+
 //
 // inline members
 //
 
-inline size_t TwoWire::available() const {
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+inline size_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::available() const {
     assert(mode_ != Unassigned); // missing begin
     assert(txAddress_ == NO_ADDRESS); // not allowed during transmission
+    assert(!asyncBusy_); // not allowed during asynchronous transfer
 
-    return bufLen_ - bufPos_;
+    return rxLen_ - rxPos_;
 }
 
-inline int TwoWire::peek() const {
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+inline int BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::peek() const {
     assert(mode_ != Unassigned); // missing begin
     assert(txAddress_ == NO_ADDRESS); // not allowed during transmission
 
-    return bufPos_ < bufLen_ ? (int)buf_[bufPos_] : -1;
+    return rxPos_ < rxLen_ ? (int)rxBuf_[rxPos_] : -1;
 }
 
-inline int TwoWire::read() {
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+inline int BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::read() {
     assert(mode_ != Unassigned); // missing begin
     assert(txAddress_ == NO_ADDRESS); // not allowed during transmission
 
-    return bufPos_ < bufLen_ ? (int)buf_[bufPos_++] : -1;
+    return rxPos_ < rxLen_ ? (int)rxBuf_[rxPos_++] : -1;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+inline uint32_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::discarded() const {
+    return discarded_;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+inline bool BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::pecValid() const {
+    assert(mode_ == Slave);
+    assert(!deferReceive_);
+
+    return i2c_slave_is_pec_valid(i2c());
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+inline bool BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::busy() const {
+    return asyncBusy_;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+inline uint8_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::result() const {
+    return asyncResult_;
+}
+
+//
+// members
+//
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::BasicTwoWire(i2c_inst_t *i2c, i2c_slave_handler_t slaveHandler,
+    irq_handler_t masterIrqHandler)
+    : i2c_(i2c), slaveHandler_(slaveHandler), masterIrqHandler_(masterIrqHandler) {
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+i2c_inst_t *BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::i2c() const {
+    assert(i2c_ == i2c0 || i2c_ == i2c1);
+
+    return i2c_;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::begin() {
+    assert(txAddress_ == NO_ADDRESS); // not allowed during transmission
+
+    if (mode_ == Slave) {
+        i2c_slave_deinit(i2c());
+    }
+    endAsync();
+    mode_ = Master;
+    rxLen_ = 0;
+    rxPos_ = 0;
+    txLen_ = 0;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::begin(uint8_t selfAddress) {
+    i2c_slave_config_t config = i2c_slave_get_default_config();
+    config.tx_threshold = 8;
+    begin(selfAddress, config);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::begin(uint8_t selfAddress, const i2c_slave_config_t &config) {
+    assert(txAddress_ == NO_ADDRESS); // not allowed during transmission
+
+    if (mode_ == Slave) {
+        i2c_slave_deinit(i2c());
+    }
+    endAsync(); // the slave takes over the I2C interrupt
+    mode_ = Slave;
+    rxLen_ = 0;
+    rxPos_ = 0;
+    txLen_ = 0;
+    txPos_ = 0;
+    txMore_ = nullptr;
+    txMoreLen_ = 0;
+    rxHead_ = 0;
+    rxTail_ = 0;
+    rxFill_ = 0;
+    rxDiscarding_ = false;
+    discarded_ = 0;
+    pec_ = config.pec;
+    instances_[i2c_hw_index(i2c())] = this;
+    i2c_slave_config_t slave_config = config;
+    slave_config.tx_streaming = true;
+    i2c_slave_init_with_config(i2c(), selfAddress, slaveHandler_ != nullptr ? slaveHandler_ : &handleSlaveEventFallback,
+        &slave_config);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::beginTransmission(uint8_t address) {
+    assert(mode_ == Master); // not allowed for slave
+    assert(txAddress_ == NO_ADDRESS); // not allowed during transmission
+    assert(!asyncBusy_); // not allowed during asynchronous transfer
+    assert(address != NO_ADDRESS);
+
+    txAddress_ = address;
+    txLen_ = 0;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+uint8_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::endTransmission(bool sendStop) {
+    assert(mode_ == Master); // not allowed for slave
+    assert(txAddress_ != NO_ADDRESS); // must follow beginTransmission()
+
+    int result = i2c_write_blocking(i2c(), txAddress_, txBuf_, txLen_, !sendStop);
+    txAddress_ = NO_ADDRESS;
+    size_t len = txLen_;
+    txLen_ = 0;
+    if (result < 0) {
+        return 4; // other error
+    } else if ((size_t)result < len) {
+        return 3; // data transfer interrupted after NACK
+    } else {
+        return 0; // success;
+    }
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+size_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::requestFrom(uint8_t address, size_t count, bool sendStop) {
+    assert(mode_ == Master); // not allowed for slave
+    assert(txAddress_ == NO_ADDRESS); // not allowed during transmission
+    assert(!asyncBusy_); // not allowed during asynchronous transfer
+
+    count = MIN(count, RxSize);
+    int result = i2c_read_blocking(i2c(), address, rxBuf_, count, !sendStop);
+    if (result < 0) {
+        result = 0;
+    }
+    rxLen_ = (RxIndex)result;
+    rxPos_ = 0;
+    return (size_t)result;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::endTransmissionAsync(bool sendStop, WireCompletionHandler handler) {
+    assert(AsyncMaster); // no command buffer
+    assert(mode_ == Master); // not allowed for slave
+    assert(txAddress_ != NO_ADDRESS); // must follow beginTransmission()
+
+    startAsync(txAddress_, false, txLen_, sendStop, handler);
+    txAddress_ = NO_ADDRESS;
+    txLen_ = 0;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::requestFromAsync(uint8_t address, size_t count, bool sendStop,
+    WireCompletionHandler handler) {
+    assert(AsyncMaster); // no command buffer
+    assert(mode_ == Master); // not allowed for slave
+    assert(txAddress_ == NO_ADDRESS); // not allowed during transmission
+
+    startAsync(address, true, MIN(count, RxSize), sendStop, handler);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+size_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::write(uint8_t value) {
+    assert(mode_ != Unassigned); // begin not called
+    assert(mode_ == Slave || txAddress_ != NO_ADDRESS); // allowed between begin...end transmission
+
+    if (txLen_ == TxSize) {
+        return 0; // buffer is full
+    }
+    txBuf_[txLen_++] = value;
+    return 1;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+size_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::write(const uint8_t *data, size_t size) {
+    assert(mode_ != Unassigned); // missing begin
+    assert(mode_ == Slave || txAddress_ != NO_ADDRESS); // allowed between begin...end transmission
+
+    // in slave mode, the response is queued and sent from the ISR
+    size_t count = MIN(size, TxSize - (size_t)txLen_);
+    memcpy(txBuf_ + txLen_, data, count);
+    txLen_ += (TxIndex)count;
+    if (mode_ == Slave && count < size && txMoreLen_ == 0) {
+        // send the rest from where it is, rather than cutting the response short
+        txMore_ = data + count;
+        txMoreLen_ = size - count;
+        return size;
+    }
+    return count;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::onReceive(WireReceiveHandler handler) {
+    receiveHandler_ = handler;
+    receiveSpanHandler_ = nullptr;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::onReceive(WireReceiveSpanHandler handler) {
+    receiveHandler_ = nullptr;
+    receiveSpanHandler_ = handler;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::onRequest(WireRequestHandler handler) {
+    requestHandler_ = handler;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::deferReceive(bool defer) {
+    assert(mode_ != Slave); // should be called before begin(selfAddress)
+    assert(!defer || RxQueueLength > 0); // no receive queue
+
+    deferReceive_ = defer;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+size_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::poll() {
+    assert(mode_ == Slave); // not allowed for master
+    assert(deferReceive_);
+
+    size_t count = 0;
+    if constexpr (RxQueueLength > 0) {
+        while (rxTail_ != rxHead_) {
+            __dmb(); // read the slot after seeing the head update
+            const RxSlot &slot = rxQueue_[rxTail_ & (RxQueueLength - 1)];
+            if (receiveSpanHandler_ != nullptr) {
+                // straight from the queue, the ISR won't reuse the slot until it's handed back
+                receiveSpanHandler_(slot.data, slot.len);
+                __dmb(); // finish with the slot before handing it back to the ISR
+                rxTail_ = rxTail_ + 1;
+                count++;
+                continue;
+            }
+            memcpy(rxBuf_, slot.data, slot.len);
+            rxLen_ = slot.len;
+            rxPos_ = 0;
+            __dmb(); // finish with the slot before handing it back to the ISR
+            rxTail_ = rxTail_ + 1;
+
+            if (receiveHandler_ != nullptr) {
+                receiveHandler_((int)rxLen_);
+            }
+            rxLen_ = 0;
+            rxPos_ = 0;
+            count++;
+        }
+    }
+    return count;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::handleSlaveEvent(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    assert(mode_ == Slave);
+
+    switch (event) {
+    case I2C_SLAVE_RECEIVE:
+        handleReceive(i2c);
+        break;
+    case I2C_SLAVE_REQUEST:
+        handleRequest(i2c);
+        break;
+    case I2C_SLAVE_REFILL:
+        sendQueued(i2c); // send more from the queue
+        break;
+    case I2C_SLAVE_FINISH:
+        handleFinish();
+        break;
+    default:
+        break;
+    }
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::handleSlaveEventFallback(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    instances_[i2c_hw_index(i2c)]->handleSlaveEvent(i2c, event);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+template <uint Index>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::handleIrqFallback() {
+    instances_[Index]->serviceAsync();
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+irq_handler_t BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::masterIrqHandler() const {
+    if (masterIrqHandler_ != nullptr) {
+        return masterIrqHandler_;
+    }
+    return i2c_hw_index(i2c()) == 0 ? &handleIrqFallback<0> : &handleIrqFallback<1>;
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::handleReceive(i2c_inst_t *i2c) {
+    assert(deferReceive_ || rxPos_ == 0);
+
+    if (RxQueueLength > 0 && deferReceive_) {
+        receiveDeferred(i2c);
+        return;
+    }
+    rxLen_ += (RxIndex)i2c_slave_read(i2c, rxBuf_ + rxLen_, RxSize - rxLen_);
+    // we can't respond with NACK when the buffer is full on DW_apb_i2c,
+    // so the excess data is simply discarded
+    discardReceived(i2c);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::handleRequest(i2c_inst_t *i2c) {
+    assert(deferReceive_ || rxLen_ == 0);
+    assert(deferReceive_ || rxPos_ == 0);
+
+    if (txPos_ == txLen_ && txMoreLen_ == 0) {
+        if (pec_ && txLen_ != 0) {
+            // the response has been sent, write nothing so the slave appends its PEC byte
+            return;
+        }
+        // the previous response (if any) has been sent, ask for more
+        txLen_ = 0;
+        txPos_ = 0;
+        if (requestHandler_ != nullptr) {
+            requestHandler_();
+        }
+    }
+    sendQueued(i2c);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::handleFinish() {
+    // master has stopped reading, drop the rest of the response
+    txLen_ = 0;
+    txPos_ = 0;
+    txMore_ = nullptr;
+    txMoreLen_ = 0;
+    if (RxQueueLength > 0 && deferReceive_) {
+        finishDeferred();
+        return;
+    }
+    if (0 < rxLen_) {
+        if (receiveSpanHandler_ != nullptr) {
+            receiveSpanHandler_(rxBuf_, rxLen_);
+        } else if (receiveHandler_ != nullptr) {
+            receiveHandler_((int)rxLen_);
+        }
+        rxLen_ = 0;
+        rxPos_ = 0;
+    }
+    assert(rxPos_ == 0);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::receiveDeferred(i2c_inst_t *i2c) {
+    if (rxFill_ == 0 && !rxDiscarding_) {
+        // first data of this transfer, check if there's room for it
+        rxDiscarding_ = (uint8_t)(rxHead_ - rxTail_) == RxQueueLength;
+    }
+    if (!rxDiscarding_) {
+        RxSlot &slot = rxQueue_[rxHead_ & (RxQueueLength - 1)];
+        rxFill_ += (RxIndex)i2c_slave_read(i2c, slot.data + rxFill_, RxSize - rxFill_);
+    }
+    // the queue is full, or the transfer doesn't fit in the buffer
+    discardReceived(i2c);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::discardReceived(i2c_inst_t *i2c) {
+    // through the slave, so the discarded data still counts towards PEC
+    uint8_t sink[16];
+    size_t count;
+    while ((count = i2c_slave_read(i2c, sink, sizeof(sink))) != 0) {
+        discarded_ = discarded_ + (uint32_t)count;
+    }
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::finishDeferred() {
+    rxDiscarding_ = false;
+    if (0 < rxFill_) {
+        rxQueue_[rxHead_ & (RxQueueLength - 1)].len = rxFill_;
+        rxFill_ = 0;
+        __dmb(); // fill the slot before publishing it
+        rxHead_ = rxHead_ + 1;
+        __sev(); // wake up poll() on the other core
+    }
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::sendQueued(i2c_inst_t *i2c) {
+    txPos_ += (TxIndex)i2c_slave_write(i2c, txBuf_ + txPos_, txLen_ - txPos_);
+    if (txPos_ == txLen_ && txMoreLen_ != 0) {
+        size_t count = i2c_slave_write(i2c, txMore_, txMoreLen_);
+        txMore_ += count;
+        txMoreLen_ -= count;
+    }
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::startAsync(uint8_t address, bool read, size_t count, bool sendStop,
+    WireCompletionHandler handler) {
+    assert(!asyncBusy_); // one transfer at a time
+    assert(count > 0); // DW_apb_i2c can't do empty transfers
+
+    auto i2c = this->i2c();
+    auto hw = i2c_get_hw(i2c);
+    uint index = i2c_hw_index(i2c);
+    if (!asyncEnabled_) {
+        asyncTxChannel_ = (uint)dma_claim_unused_channel(true);
+        asyncRxChannel_ = (uint)dma_claim_unused_channel(true);
+
+        // 16-bit writes, so each command word goes into IC_DATA_CMD whole
+        dma_channel_config c = dma_channel_get_default_config(asyncTxChannel_);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_dreq(&c, i2c_get_dreq(i2c, true));
+        dma_channel_configure(asyncTxChannel_, &c, &hw->data_cmd, cmdBuf_.data(), 0, false);
+
+        c = dma_channel_get_default_config(asyncRxChannel_);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+        channel_config_set_read_increment(&c, false);
+        channel_config_set_write_increment(&c, true);
+        channel_config_set_dreq(&c, i2c_get_dreq(i2c, false));
+        dma_channel_configure(asyncRxChannel_, &c, rxBuf_, &hw->data_cmd, 0, false);
+
+        hw->dma_tdlr = 8;
+        hw->dma_rdlr = 0;
+        hw->intr_mask = 0;
+        instances_[index] = this;
+        uint num = I2C0_IRQ + index;
+        irq_set_exclusive_handler(num, masterIrqHandler());
+        irq_set_enabled(num, true);
+        asyncEnabled_ = true;
+    }
+
+    // same encoding as i2c_write_blocking() / i2c_read_blocking()
+    for (size_t i = 0; i < count; i++) {
+        uint16_t cmd = read ? I2C_IC_DATA_CMD_CMD_BITS : txBuf_[i];
+        if (i == 0 && i2c->restart_on_next) {
+            cmd |= I2C_IC_DATA_CMD_RESTART_BITS;
+        }
+        if (i == count - 1 && sendStop) {
+            cmd |= I2C_IC_DATA_CMD_STOP_BITS;
+        }
+        cmdBuf_[i] = cmd;
+    }
+
+    hw->enable = 0;
+    hw->tar = address;
+    hw->enable = 1;
+    hw->clr_intr; // discard events from earlier transfers
+
+    completionHandler_ = handler;
+    asyncRead_ = read;
+    asyncStop_ = sendStop;
+    asyncLen_ = count;
+    asyncResult_ = 0;
+    asyncBusy_ = true;
+    rxLen_ = 0;
+    rxPos_ = 0;
+
+    uint32_t dma_cr = I2C_IC_DMA_CR_TDMAE_BITS;
+    if (read) {
+        dma_channel_transfer_to_buffer_now(asyncRxChannel_, rxBuf_, count);
+        dma_cr |= I2C_IC_DMA_CR_RDMAE_BITS;
+    }
+    dma_channel_transfer_from_buffer_now(asyncTxChannel_, cmdBuf_.data(), count);
+    hw->dma_cr = dma_cr;
+    // Unmasked once the Tx FIFO is being filled. With TX_EMPTY_CTRL (set by i2c_init()), TX_EMPTY
+    // is only raised after the last command has been processed.
+    hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS | (sendStop ? I2C_IC_INTR_MASK_M_STOP_DET_BITS : I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::serviceAsync() {
+    auto hw = i2c_get_hw(i2c_);
+    uint32_t intr_stat = hw->intr_stat;
+    if (intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        uint32_t abort_source = hw->tx_abrt_source;
+        hw->clr_tx_abrt;
+        dma_channel_abort(asyncTxChannel_);
+        dma_channel_abort(asyncRxChannel_);
+        if (abort_source & I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS) {
+            finishAsync(2); // address NACK
+        } else if (abort_source & I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS) {
+            finishAsync(3); // data NACK
+        } else {
+            finishAsync(4); // other error
+        }
+    } else if (intr_stat & (I2C_IC_INTR_STAT_R_STOP_DET_BITS | I2C_IC_INTR_STAT_R_TX_EMPTY_BITS)) {
+        hw->clr_stop_det;
+        if (dma_channel_is_busy(asyncTxChannel_)) {
+            return; // DMA is about to write more commands
+        }
+        while (asyncRead_ && dma_channel_is_busy(asyncRxChannel_)) {
+            tight_loop_contents(); // the last byte is already in the Rx FIFO
+        }
+        finishAsync(0);
+    }
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+__force_inline void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::finishAsync(uint8_t result) {
+    auto hw = i2c_get_hw(i2c_);
+    hw->intr_mask = 0;
+    hw->dma_cr = 0;
+    i2c_->restart_on_next = !asyncStop_;
+    if (asyncRead_) {
+        rxLen_ = (RxIndex)(asyncLen_ - dma_hw->ch[asyncRxChannel_].transfer_count);
+        rxPos_ = 0;
+    }
+    asyncResult_ = result;
+    asyncBusy_ = false;
+    if (completionHandler_ != nullptr) {
+        completionHandler_(result);
+    }
+}
+
+template <size_t RxSize, size_t TxSize, size_t RxQueueLength, bool AsyncMaster>
+void BasicTwoWire<RxSize, TxSize, RxQueueLength, AsyncMaster>::endAsync() {
+    if (!asyncEnabled_) {
+        return;
+    }
+    assert(!asyncBusy_); // wait for the asynchronous transfer to finish
+
+    auto i2c = this->i2c();
+    uint index = i2c_hw_index(i2c);
+    uint num = I2C0_IRQ + index;
+    irq_set_enabled(num, false);
+    irq_remove_handler(num, masterIrqHandler());
+    instances_[index] = nullptr;
+    i2c_get_hw(i2c)->intr_mask = I2C_IC_INTR_MASK_RESET;
+
+    dma_channel_unclaim(asyncTxChannel_);
+    dma_channel_unclaim(asyncRxChannel_);
+    asyncEnabled_ = false;
 }
 
 #endif
@@ -29,6 +29,11 @@ static struct
     uint8_t mem_address;
 } context;
 
+// The master sends writes asynchronously, which the global Wire1 leaves out to save memory. This
+// instance on i2c1 takes its place.
+using MasterWire = BasicTwoWire<WIRE_BUFFER_LENGTH, WIRE_BUFFER_LENGTH, 0, true /* AsyncMaster */>;
+WIRE_DEFINE_INSTANCE(MasterWire, masterWire, i2c1)
+
 static void slave_on_receive(int count) {
     // writes always start with the memory address
     hard_assert(Wire.available());
@@ -78,7 +83,7 @@ static void run_master() {
     i2c_init(i2c1, I2C_BAUDRATE);
 
     // setup Wire for master mode on i2c1
-    Wire1.begin();
+    masterWire.begin();
 
     for (uint8_t mem_address = 0;; mem_address = (mem_address + 32) % 256) {
         char msg[32];
@@ -87,36 +92,41 @@ static void run_master() {
 
         // write message at mem_address
         printf("Write at 0x%02X: '%s'\n", mem_address, msg);
-        Wire1.beginTransmission(I2C_SLAVE_ADDRESS);
-        Wire1.write(mem_address);
-        Wire1.write((const uint8_t *)msg, msg_len);
-        uint8_t result = Wire1.endTransmission(true /* sendStop */);
+        masterWire.beginTransmission(I2C_SLAVE_ADDRESS);
+        masterWire.write(mem_address);
+        masterWire.write((const uint8_t *)msg, msg_len);
+        // the write goes out using DMA, leaving this core free in the meantime
+        masterWire.endTransmissionAsync(true /* sendStop */);
+        while (masterWire.busy()) {
+            tight_loop_contents();
+        }
+        uint8_t result = masterWire.result();
         if (result != 0) {
             puts("Couldn't write to slave, please check your wiring!");
             return;
         }
 
         // seek to mem_address
-        Wire1.beginTransmission(I2C_SLAVE_ADDRESS);
-        Wire1.write(mem_address);
-        result = Wire1.endTransmission(false /* sendStop */);
+        masterWire.beginTransmission(I2C_SLAVE_ADDRESS);
+        masterWire.write(mem_address);
+        result = masterWire.endTransmission(false /* sendStop */);
         hard_assert(result == 0);
         uint8_t buf[32];
         // partial read
         uint8_t split = 5;
-        uint8_t count = Wire1.requestFrom(I2C_SLAVE_ADDRESS, split, false /* sendStop */);
+        uint8_t count = masterWire.requestFrom(I2C_SLAVE_ADDRESS, split, false /* sendStop */);
         hard_assert(count == split);
         for (size_t i = 0; i < count; i++) {
-            buf[i] = Wire1.read();
+            buf[i] = masterWire.read();
         }
         buf[count] = '\0';
         printf("Read  at 0x%02X: '%s'\n", mem_address, buf);
         hard_assert(memcmp(buf, msg, split) == 0);
         // read the remaining bytes, continuing from last address
-        count = Wire1.requestFrom(I2C_SLAVE_ADDRESS, msg_len - split, true /* sendStop */);
+        count = masterWire.requestFrom(I2C_SLAVE_ADDRESS, msg_len - split, true /* sendStop */);
         hard_assert(count == (size_t)(msg_len - split));
         for (size_t i = 0; i < count; i++) {
-            buf[i] = Wire1.read();
+            buf[i] = masterWire.read();
         }
         buf[count] = '\0';
         printf("Read  at 0x%02X: '%s'\n", mem_address + split, buf);
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <pio_i2c_slave.h>
+#include <pico/stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint8_t MEM_ADDRESS = 0x17;
+// next to MEM_ADDRESS, so PIO can check both at once, see pio_i2c_slave.h
+static const uint8_t MAILBOX_ADDRESS = 0x16;
+static const uint I2C_BAUDRATE = 100000; // 100 kHz
+
+// For this example, we run both the master and slave from the same board.
+// You'll need to wire pin GP4 to GP6 (SDA), and pin GP5 to GP7 (SCL).
+static const uint PIO_SLAVE_SDA_PIN = 4; // SCL is on the next pin
+static const uint I2C_MASTER_SDA_PIN = 6;
+static const uint I2C_MASTER_SCL_PIN = 7;
+
+// A single PIO port emulates two devices. At MEM_ADDRESS there is the same 256 byte memory as
+// in example_mem. At MAILBOX_ADDRESS, master can leave up to 8 bytes. Further bytes are NACKed,
+// until the mailbox is emptied by reading it.
+static struct
+{
+    uint8_t mem[256];
+    uint8_t mem_address;
+    bool mem_address_written;
+    uint8_t mailbox[8];
+    uint8_t mailbox_len;
+    uint8_t mailbox_pos;
+} context;
+
+static pio_i2c_slave_t slave;
+
+// Our handler is called from the PIO ISR, so it must complete quickly.
+static void slave_handler(pio_i2c_slave_t *slave, i2c_slave_event_t event) {
+    bool is_mem = pio_i2c_slave_get_address(slave) == MEM_ADDRESS;
+
+    switch (event) {
+    case I2C_SLAVE_RECEIVE: // master has written a byte
+        if (is_mem) {
+            if (!context.mem_address_written) {
+                // writes always start with the memory address
+                context.mem_address = pio_i2c_slave_read_byte(slave);
+                context.mem_address_written = true;
+            } else {
+                context.mem[context.mem_address++] = pio_i2c_slave_read_byte(slave);
+            }
+        } else if (context.mailbox_len < sizeof(context.mailbox)) {
+            context.mailbox[context.mailbox_len++] = pio_i2c_slave_read_byte(slave);
+        } else {
+            pio_i2c_slave_nack(slave); // full
+        }
+        break;
+    case I2C_SLAVE_REQUEST: // master is requesting a byte
+        if (is_mem) {
+            pio_i2c_slave_write_byte(slave, context.mem[context.mem_address++]);
+        } else if (context.mailbox_pos < context.mailbox_len) {
+            pio_i2c_slave_write_byte(slave, context.mailbox[context.mailbox_pos++]);
+        }
+        break;
+    case I2C_SLAVE_FINISH: // master has signalled Stop / Restart
+        context.mem_address_written = false;
+        if (!is_mem && context.mailbox_pos != 0) {
+            // read out, make room for new mail
+            context.mailbox_len = 0;
+            context.mailbox_pos = 0;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void setup_slave() {
+    pio_i2c_slave_config_t config = pio_i2c_slave_get_default_config(pio0, PIO_SLAVE_SDA_PIN, MEM_ADDRESS);
+    config.addresses[config.num_addresses++] = MAILBOX_ADDRESS;
+    pio_i2c_slave_init(&slave, &config, &slave_handler);
+}
+
+static void run_master() {
+    gpio_init(I2C_MASTER_SDA_PIN);
+    gpio_set_function(I2C_MASTER_SDA_PIN, GPIO_FUNC_I2C);
+    // pull-ups are already active on slave side, this is just a fail-safe in case the wiring is faulty
+    gpio_pull_up(I2C_MASTER_SDA_PIN);
+
+    gpio_init(I2C_MASTER_SCL_PIN);
+    gpio_set_function(I2C_MASTER_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_MASTER_SCL_PIN);
+
+    i2c_init(i2c1, I2C_BAUDRATE);
+
+    for (uint8_t mem_address = 0;; mem_address = (mem_address + 32) % 256) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "Hello, PIO slave! - 0x%02X", mem_address);
+        uint8_t msg_len = strlen(msg);
+
+        uint8_t buf[32];
+        buf[0] = mem_address;
+        memcpy(buf + 1, msg, msg_len);
+        // write message at mem_address
+        printf("Write at 0x%02X: '%s'\n", mem_address, msg);
+        int count = i2c_write_blocking(i2c1, MEM_ADDRESS, buf, 1 + msg_len, false);
+        if (count < 0) {
+            puts("Couldn't write to slave, please check your wiring!");
+            return;
+        }
+        hard_assert(count == 1 + msg_len);
+
+        // seek to mem_address, and read back
+        count = i2c_write_blocking(i2c1, MEM_ADDRESS, buf, 1, true);
+        hard_assert(count == 1);
+        count = i2c_read_blocking(i2c1, MEM_ADDRESS, buf, msg_len, false);
+        hard_assert(count == msg_len);
+        buf[count] = '\0';
+        printf("Read  at 0x%02X: '%s'\n", mem_address, buf);
+        hard_assert(memcmp(buf, msg, msg_len) == 0);
+
+        // The mailbox takes 8 bytes. The 9th is NACKed, so the SDK reports an error rather than
+        // a partial count.
+        count = i2c_write_blocking(i2c1, MAILBOX_ADDRESS, (const uint8_t *)msg, 8, false);
+        hard_assert(count == 8);
+        count = i2c_write_blocking(i2c1, MAILBOX_ADDRESS, (const uint8_t *)"x", 1, false);
+        printf("Mailbox full, write returned %d\n", count);
+        hard_assert(count < 0);
+        count = i2c_read_blocking(i2c1, MAILBOX_ADDRESS, buf, 8, false);
+        hard_assert(count == 8);
+        printf("Mailbox: '%.8s'\n", buf);
+        hard_assert(memcmp(buf, msg, 8) == 0);
+
+        puts("");
+        sleep_ms(2000);
+    }
+}
+
+int main() {
+    stdio_init_all();
+    puts("\nI2C slave example on PIO");
+
+    setup_slave();
+    run_master();
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <i2c_regmap.h>
+#include <pico/stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint I2C_SLAVE_ADDRESS = 0x17;
+static const uint I2C_BAUDRATE = 100000; // 100 kHz
+
+// For this example, we run both the master and slave from the same board.
+// You'll need to wire pin GP4 to GP6 (SDA), and pin GP5 to GP7 (SCL).
+static const uint I2C_SLAVE_SDA_PIN = PICO_DEFAULT_I2C_SDA_PIN; // 4
+static const uint I2C_SLAVE_SCL_PIN = PICO_DEFAULT_I2C_SCL_PIN; // 5
+static const uint I2C_MASTER_SDA_PIN = 6;
+static const uint I2C_MASTER_SCL_PIN = 7;
+
+// The slave implements the same 256 byte memory as example_mem, using the built-in register
+// map instead of a custom handler. The last 16 bytes hold a read-only identification string.
+static uint8_t mem[256];
+
+static const i2c_regmap_range_t ranges[] = {
+    {.start = 240, .size = 16, .flags = I2C_REGMAP_READ_ONLY},
+};
+
+static i2c_regmap_t regmap;
+
+static void setup_slave() {
+    gpio_init(I2C_SLAVE_SDA_PIN);
+    gpio_set_function(I2C_SLAVE_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SLAVE_SDA_PIN);
+
+    gpio_init(I2C_SLAVE_SCL_PIN);
+    gpio_set_function(I2C_SLAVE_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SLAVE_SCL_PIN);
+
+    strncpy((char *)mem + 240, "pico_i2c_slave", 16);
+
+    i2c_regmap_config_t config = i2c_regmap_get_default_config(mem, sizeof(mem));
+    config.ranges = ranges;
+    config.num_ranges = count_of(ranges);
+    // master below reads by writing the address, then reading after a Restart, so stage the
+    // response early
+    config.prefill = true;
+    i2c_regmap_init(&regmap, &config);
+
+    i2c_init(i2c0, I2C_BAUDRATE);
+    // configure I2C0 for slave mode, serving the register map
+    i2c_regmap_slave_init(i2c0, I2C_SLAVE_ADDRESS, &regmap);
+}
+
+static void run_master() {
+    gpio_init(I2C_MASTER_SDA_PIN);
+    gpio_set_function(I2C_MASTER_SDA_PIN, GPIO_FUNC_I2C);
+    // pull-ups are already active on slave side, this is just a fail-safe in case the wiring is faulty
+    gpio_pull_up(I2C_MASTER_SDA_PIN);
+
+    gpio_init(I2C_MASTER_SCL_PIN);
+    gpio_set_function(I2C_MASTER_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_MASTER_SCL_PIN);
+
+    i2c_init(i2c1, I2C_BAUDRATE);
+
+    for (uint8_t mem_address = 0;; mem_address = (mem_address + 32) % 224) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "Hello, I2C slave! - 0x%02X", mem_address);
+        uint8_t msg_len = strlen(msg);
+
+        uint8_t buf[32];
+        buf[0] = mem_address;
+        memcpy(buf + 1, msg, msg_len);
+        // write message at mem_address
+        printf("Write at 0x%02X: '%s'\n", mem_address, msg);
+        int count = i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, buf, 1 + msg_len, false);
+        if (count < 0) {
+            puts("Couldn't write to slave, please check your wiring!");
+            return;
+        }
+        hard_assert(count == 1 + msg_len);
+
+        // seek to mem_address
+        count = i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, buf, 1, true);
+        hard_assert(count == 1);
+        // partial read
+        uint8_t split = 5;
+        count = i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, buf, split, true);
+        hard_assert(count == split);
+        buf[count] = '\0';
+        printf("Read  at 0x%02X: '%s'\n", mem_address, buf);
+        hard_assert(memcmp(buf, msg, split) == 0);
+        // read the remaining bytes, continuing from last address
+        count = i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, buf, msg_len - split, false);
+        hard_assert(count == msg_len - split);
+        buf[count] = '\0';
+        printf("Read  at 0x%02X: '%s'\n", mem_address + split, buf);
+        hard_assert(memcmp(buf, msg + split, msg_len - split) == 0);
+
+        // try to overwrite the read-only range, which should be ignored
+        buf[0] = 240;
+        memset(buf + 1, 'x', 16);
+        count = i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, buf, 1 + 16, false);
+        hard_assert(count == 1 + 16);
+        count = i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, buf, 1, true);
+        hard_assert(count == 1);
+        count = i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, buf, 16, false);
+        hard_assert(count == 16);
+        printf("Read  at 0xF0: '%.16s'\n", buf);
+        hard_assert(memcmp(buf, "pico_i2c_slave", 14) == 0);
+
+        puts("");
+        sleep_ms(2000);
+    }
+}
+
+int main() {
+    stdio_init_all();
+    puts("\nI2C slave example with register map");
+
+    setup_slave();
+    run_master();
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "Wire.h"
+#include <i2c_fifo.h>
+#include <i2c_regmap.h>
+#include <i2c_slave.h>
+#include <i2c_slave.hpp>
+#include <sim_i2c.h>
+#include <stdio.h>
+#include <string.h>
+
+// Same slave paths as bench_i2c_slave, run against the simulated I2C block. There is no bus
+// timing here, so instead of throughput this reports the work each path does per byte: ISR
+// runs, register accesses, and host time in the ISR with the cost of the register traps taken
+// out. Data written is read back and checked, so a nonzero error count is a bug.
+
+static const uint I2C_SLAVE_ADDRESS = 0x17;
+
+static const size_t SIZES[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+static const size_t MAX_SIZE = 256;
+static const size_t BYTES_PER_POINT = 4096;
+static const size_t MIN_ITERATIONS = 16;
+
+static struct
+{
+    uint8_t mem[MAX_SIZE];
+    uint8_t mem_address;
+    bool mem_address_written;
+} context;
+
+//
+// raw i2c_slave handler
+//
+
+static inline void mem_receive(i2c_inst_t *i2c) {
+    for (size_t n = i2c_get_read_available(i2c); n > 0; n--) {
+        uint8_t value = i2c_read_byte(i2c);
+        if (!context.mem_address_written) {
+            context.mem_address = value;
+            context.mem_address_written = true;
+        } else {
+            context.mem[context.mem_address++] = value;
+        }
+    }
+}
+
+static inline void mem_request(i2c_inst_t *i2c) {
+    i2c_write_byte(i2c, context.mem[context.mem_address++]);
+}
+
+static inline void mem_finish() {
+    context.mem_address_written = false;
+}
+
+static void raw_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    switch (event) {
+    case I2C_SLAVE_RECEIVE:
+        mem_receive(i2c);
+        break;
+    case I2C_SLAVE_REQUEST:
+        mem_request(i2c);
+        break;
+    case I2C_SLAVE_FINISH:
+        mem_finish();
+        break;
+    default:
+        break;
+    }
+}
+
+static void setup_raw() {
+    context.mem_address_written = false;
+    i2c_slave_init(i2c0, I2C_SLAVE_ADDRESS, &raw_handler);
+}
+
+static void teardown_raw() {
+    i2c_slave_deinit(i2c0);
+}
+
+//
+// compile-time handler
+//
+
+struct TemplateHandler
+{
+    static void onReceive(i2c_inst_t *i2c) {
+        mem_receive(i2c);
+    }
+
+    static void onRequest(i2c_inst_t *i2c) {
+        mem_request(i2c);
+    }
+
+    static void onFinish(i2c_inst_t *) {
+        mem_finish();
+    }
+};
+
+using TemplateSlave = I2cSlave<0, TemplateHandler>;
+
+I2C_SLAVE_DEFINE_IRQ_HANDLER(0, TemplateHandler)
+
+static void setup_template() {
+    context.mem_address_written = false;
+    TemplateSlave::init(I2C_SLAVE_ADDRESS);
+}
+
+static void teardown_template() {
+    TemplateSlave::deinit();
+}
+
+//
+// register map
+//
+
+static i2c_regmap_t regmap;
+
+static void setup_regmap() {
+    i2c_regmap_config_t config = i2c_regmap_get_default_config(context.mem, sizeof(context.mem));
+    i2c_regmap_init(&regmap, &config);
+    i2c_regmap_slave_init(i2c0, I2C_SLAVE_ADDRESS, &regmap);
+}
+
+static void teardown_regmap() {
+    i2c_slave_deinit(i2c0);
+}
+
+static void setup_regmap_prefill() {
+    i2c_regmap_config_t config = i2c_regmap_get_default_config(context.mem, sizeof(context.mem));
+    config.prefill = true;
+    i2c_regmap_init(&regmap, &config);
+    i2c_regmap_slave_init(i2c0, I2C_SLAVE_ADDRESS, &regmap);
+}
+
+//
+// Wire
+//
+
+// TxSize covers copying a response of the whole memory, see bench_i2c_slave
+using BenchWire = BasicTwoWire<1 + MAX_SIZE, MAX_SIZE>;
+WIRE_DEFINE_INSTANCE(BenchWire, wire, i2c0)
+
+static void wire_on_receive(int) {
+    context.mem_address = (uint8_t)wire.read();
+    while (wire.available()) {
+        context.mem[context.mem_address++] = (uint8_t)wire.read();
+    }
+}
+
+static void wire_on_request() {
+    uint8_t address = context.mem_address;
+    wire.write(context.mem + address, MAX_SIZE - address);
+    wire.write(context.mem, address);
+}
+
+static void setup_wire() {
+    wire.onReceive(wire_on_receive);
+    wire.onRequest(wire_on_request);
+    wire.begin(I2C_SLAVE_ADDRESS);
+}
+
+static void teardown_wire() {
+    wire.begin();
+}
+
+//
+// benchmark
+//
+
+struct BenchPath
+{
+    const char *name;
+    void (*setup)();
+    void (*teardown)();
+};
+
+static const BenchPath PATHS[] = {
+    {"raw", &setup_raw, &teardown_raw},
+    {"template", &setup_template, &teardown_template},
+    {"regmap", &setup_regmap, &teardown_regmap},
+    {"regmap_prefill", &setup_regmap_prefill, &teardown_regmap},
+    {"wire", &setup_wire, &teardown_wire},
+};
+
+static void fill_pattern(uint8_t *buf, size_t size, uint seed) {
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)(seed * 31 + i * 7);
+    }
+}
+
+static uint run_point(const BenchPath &path, size_t size) {
+    size_t iterations = MAX(MIN_ITERATIONS, BYTES_PER_POINT / size);
+    uint8_t out[1 + MAX_SIZE];
+    uint8_t in[MAX_SIZE];
+    uint errors = 0;
+
+    sim_i2c_reset_stats(i2c0);
+    for (size_t i = 0; i < iterations; i++) {
+        out[0] = 0;
+        fill_pattern(out + 1, size, i);
+        int count = i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, 1 + size, false);
+        count += i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, 1, true);
+        count += i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, in, size, false);
+        if (count != (int)(2 + 2 * size) || memcmp(in, out + 1, size) != 0) {
+            errors++;
+        }
+    }
+
+    sim_i2c_stats_t stats;
+    sim_i2c_get_stats(i2c0, &stats);
+    // payload bytes, both directions
+    double bytes = 2.0 * size * iterations;
+    double code_ns = stats.isr_ns - stats.isr_accesses * sim_i2c_access_ns();
+
+    printf("%s,%u,%u,%u,%.2f,%.2f,%.1f,%u,%.1f,%u\n",
+        path.name, (uint)size, (uint)iterations, errors,
+        stats.isr_calls / bytes, stats.isr_accesses / bytes,
+        MAX(code_ns, 0.0) / stats.isr_calls,
+        (uint)stats.stretches, (double)stats.stretch_accesses / iterations, (uint)stats.isr_storms);
+    return errors;
+}
+
+int main() {
+    printf("I2C slave benchmark on the host simulator, %.0f ns per register access\n", sim_i2c_access_ns());
+    // One line per data point. Per byte figures count payload bytes written plus bytes read.
+    // isr_ns_avg is the host time per ISR run, minus register traps. stretch_accesses_per_read
+    // counts register accesses while master waits on RD_REQ, for how long reads are stretched.
+    puts("# path,size,iterations,errors,isr_calls_per_byte,isr_accesses_per_byte,isr_ns_avg,"
+         "stretches,stretch_accesses_per_read,isr_storms");
+
+    uint errors = 0;
+    for (const BenchPath &path : PATHS) {
+        i2c_init(i2c0, 100000);
+        i2c_init(i2c1, 100000);
+        path.setup();
+        for (size_t size : SIZES) {
+            errors += run_point(path, size);
+        }
+        path.teardown();
+    }
+    puts("# done");
+    return errors == 0 ? 0 : 1;
+}
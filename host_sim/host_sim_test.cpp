@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "Wire.h"
+#include <i2c_pec.h>
+#include <i2c_regmap.h>
+#include <i2c_slave.h>
+#include <sim_i2c.h>
+#include <stdio.h>
+#include <string.h>
+
+// Behavior checks on the host simulator, for slave setups the examples and the benchmark don't
+// cover. Each test sets up i2c0 as slave, drives it from i2c1 as master, and tears it down.
+
+static const uint I2C_SLAVE_ADDRESS = 0x17;
+
+static uint failures;
+
+#define CHECK(condition)                                                     \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+//
+// callbacks without receive
+//
+
+static const uint8_t REPLY[] = {0x11, 0x22, 0x33};
+
+struct RequestOnlyContext
+{
+    uint requests;
+    uint finishes;
+};
+
+static void request_only_request(i2c_inst_t *i2c, void *user) {
+    auto context = static_cast<RequestOnlyContext *>(user);
+    context->requests++;
+    i2c_slave_write(i2c, REPLY, sizeof(REPLY));
+}
+
+static void request_only_finish(i2c_inst_t *, void *user) {
+    static_cast<RequestOnlyContext *>(user)->finishes++;
+}
+
+static void test_request_only_callbacks() {
+    RequestOnlyContext context = {};
+    i2c_slave_callbacks_t callbacks = {};
+    callbacks.request = &request_only_request;
+    callbacks.finish = &request_only_finish;
+    callbacks.user = &context;
+    i2c_slave_config_t config = i2c_slave_get_default_config();
+    i2c_slave_init_with_callbacks(i2c0, I2C_SLAVE_ADDRESS, &callbacks, &config);
+
+    // written data has nowhere to go, and must be dropped rather than stall the slave
+    uint8_t out[20];
+    memset(out, 0xab, sizeof(out));
+    CHECK(i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, sizeof(out), false) == (int)sizeof(out));
+    CHECK(i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, 1, true) == 1);
+    uint8_t in[sizeof(REPLY)];
+    CHECK(i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, in, sizeof(in), false) == (int)sizeof(in));
+    CHECK(memcmp(in, REPLY, sizeof(REPLY)) == 0);
+    CHECK(context.requests == 1);
+    CHECK(context.finishes == 3);
+
+    i2c_slave_stats_t stats;
+    i2c_slave_get_stats(i2c0, &stats);
+    CHECK(stats.rx_bytes == sizeof(out) + 1);
+    CHECK(stats.rx_overflows == 0);
+
+    i2c_slave_deinit(i2c0);
+}
+
+//
+// PEC
+//
+
+static const uint8_t PEC_COMMAND = 0x42;
+static const uint8_t PEC_DATA[] = {0x01, 0x02, 0x03, 0x04, 0x05};
+
+// master side: command and data, followed by PEC
+static void make_pec_write(uint8_t *out) {
+    memcpy(out, PEC_DATA, sizeof(PEC_DATA));
+    uint8_t pec = i2c_pec_update(0, i2c_pec_address_byte(I2C_SLAVE_ADDRESS, false));
+    out[sizeof(PEC_DATA)] = i2c_pec_update_buf(pec, PEC_DATA, sizeof(PEC_DATA));
+}
+
+// PEC expected at the end of a read of REPLY, after writing PEC_COMMAND with Restart
+static uint8_t expected_read_pec() {
+    uint8_t pec = i2c_pec_update(0, i2c_pec_address_byte(I2C_SLAVE_ADDRESS, false));
+    pec = i2c_pec_update(pec, PEC_COMMAND);
+    pec = i2c_pec_update(pec, i2c_pec_address_byte(I2C_SLAVE_ADDRESS, true));
+    return i2c_pec_update_buf(pec, REPLY, sizeof(REPLY));
+}
+
+// Writes PEC_DATA with a good then a bad PEC, and reads REPLY past its end. After each write,
+// `write_valid` tells whether the slave got the data and found the PEC valid.
+static void run_pec_transfers(bool (*write_valid)()) {
+    uint8_t out[sizeof(PEC_DATA) + 1];
+    make_pec_write(out);
+    CHECK(i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, sizeof(out), false) == (int)sizeof(out));
+    CHECK(write_valid());
+    out[sizeof(PEC_DATA)] ^= 1;
+    CHECK(i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, sizeof(out), false) == (int)sizeof(out));
+    CHECK(!write_valid());
+
+    // one byte more than the reply, for the PEC
+    CHECK(i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, &PEC_COMMAND, 1, true) == 1);
+    uint8_t in[sizeof(REPLY) + 1];
+    CHECK(i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, in, sizeof(in), false) == (int)sizeof(in));
+    CHECK(memcmp(in, REPLY, sizeof(REPLY)) == 0);
+    CHECK(in[sizeof(REPLY)] == expected_read_pec());
+}
+
+static struct
+{
+    uint8_t received[16];
+    size_t received_len;
+    size_t reply_pos;
+    bool write_valid; // data and PEC of the last write
+} pec_handler_context;
+
+static bool pec_handler_write_valid() {
+    bool valid = pec_handler_context.write_valid;
+    pec_handler_context.write_valid = false;
+    return valid;
+}
+
+static void pec_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    auto &context = pec_handler_context;
+    switch (event) {
+    case I2C_SLAVE_RECEIVE:
+        context.received_len += i2c_slave_read(i2c, context.received + context.received_len,
+            sizeof(context.received) - context.received_len);
+        break;
+    case I2C_SLAVE_REQUEST:
+        // writing nothing once the reply is out lets the slave append PEC
+        context.reply_pos += i2c_slave_write(i2c, REPLY + context.reply_pos, sizeof(REPLY) - context.reply_pos);
+        break;
+    case I2C_SLAVE_FINISH:
+        if (context.received_len > 1) { // not the command before a read
+            context.write_valid = context.received_len == sizeof(PEC_DATA) + 1 &&
+                                  memcmp(context.received, PEC_DATA, sizeof(PEC_DATA)) == 0 &&
+                                  i2c_slave_is_pec_valid(i2c);
+        }
+        context.received_len = 0;
+        context.reply_pos = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+static void test_pec_handler() {
+    pec_handler_context = {};
+    i2c_slave_config_t config = i2c_slave_get_default_config();
+    config.pec = true;
+    i2c_slave_init_with_config(i2c0, I2C_SLAVE_ADDRESS, &pec_handler, &config);
+
+    run_pec_transfers(&pec_handler_write_valid);
+
+    i2c_slave_deinit(i2c0);
+}
+
+static struct
+{
+    bool received;
+    bool pec_valid;
+} pec_wire_context;
+
+static bool pec_wire_write_valid() {
+    bool valid = pec_wire_context.received && pec_wire_context.pec_valid;
+    pec_wire_context = {};
+    return valid;
+}
+
+static void pec_wire_receive(const uint8_t *data, size_t len) {
+    if (len == 1) {
+        return; // command before a read
+    }
+    pec_wire_context.received = len == sizeof(PEC_DATA) + 1 && memcmp(data, PEC_DATA, sizeof(PEC_DATA)) == 0;
+    pec_wire_context.pec_valid = Wire.pecValid();
+}
+
+static void pec_wire_request() {
+    Wire.write(REPLY, sizeof(REPLY));
+}
+
+static void test_pec_wire() {
+    pec_wire_context = {};
+    i2c_slave_config_t config = i2c_slave_get_default_config();
+    config.pec = true;
+    Wire.onReceive(pec_wire_receive);
+    Wire.onRequest(pec_wire_request);
+    Wire.begin(I2C_SLAVE_ADDRESS, config);
+
+    run_pec_transfers(&pec_wire_write_valid);
+
+    Wire.begin();
+}
+
+//
+// Wire response longer than TxSize
+//
+
+static uint8_t long_reply[200];
+
+static void long_reply_request() {
+    Wire.write(long_reply, sizeof(long_reply));
+}
+
+static void test_wire_long_reply() {
+    static_assert(sizeof(long_reply) > TwoWire::TX_BUFFER_LENGTH, "must not fit in the buffer");
+    for (uint i = 0; i < sizeof(long_reply); i++) {
+        long_reply[i] = (uint8_t)(i * 7);
+    }
+    Wire.onReceive((WireReceiveHandler) nullptr);
+    Wire.onRequest(long_reply_request);
+    Wire.begin(I2C_SLAVE_ADDRESS);
+
+    uint8_t in[sizeof(long_reply)];
+    CHECK(i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, in, sizeof(in), false) == (int)sizeof(in));
+    CHECK(memcmp(in, long_reply, sizeof(long_reply)) == 0);
+
+    Wire.begin();
+}
+
+//
+// Wire deferred receive
+//
+
+using QueueWire = BasicTwoWire<WIRE_BUFFER_LENGTH, WIRE_BUFFER_LENGTH, 2>;
+WIRE_DEFINE_INSTANCE(QueueWire, queue_wire, i2c0)
+
+// the default type leaves out the queue
+static_assert(sizeof(QueueWire) >= sizeof(TwoWire) + 2 * WIRE_BUFFER_LENGTH, "queue not opt-in");
+
+static struct
+{
+    uint8_t data[4];
+    uint count;
+} deferred_context;
+
+static void deferred_receive(const uint8_t *data, size_t len) {
+    CHECK(len == 2);
+    CHECK(data[0] == 0xA0);
+    deferred_context.data[deferred_context.count++ % sizeof(deferred_context.data)] = data[1];
+}
+
+static void test_wire_deferred_receive() {
+    deferred_context.count = 0;
+    queue_wire.onReceive(deferred_receive);
+    queue_wire.deferReceive();
+    queue_wire.begin(I2C_SLAVE_ADDRESS);
+
+    // the third write finds the queue full
+    for (uint8_t i = 0; i < 3; i++) {
+        const uint8_t out[] = {0xA0, i};
+        CHECK(i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, sizeof(out), false) == (int)sizeof(out));
+    }
+    CHECK(deferred_context.count == 0);
+    CHECK(queue_wire.poll() == 2);
+    CHECK(deferred_context.count == 2);
+    CHECK(deferred_context.data[0] == 0 && deferred_context.data[1] == 1);
+    CHECK(queue_wire.discarded() == 2);
+
+    const uint8_t out[] = {0xA0, 3};
+    CHECK(i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, out, sizeof(out), false) == (int)sizeof(out));
+    CHECK(queue_wire.poll() == 1);
+    CHECK(deferred_context.count == 3 && deferred_context.data[2] == 3);
+
+    queue_wire.begin();
+}
+
+//
+// regmap prefill
+//
+
+// Reads past the staged bytes after writing the register address, and returns the number of
+// reads which were staged.
+static uint run_prefill_read(bool shadow) {
+    static uint8_t mem[64];
+    static uint8_t shadow_mem[64];
+    for (uint i = 0; i < sizeof(mem); i++) {
+        mem[i] = (uint8_t)i;
+    }
+    i2c_regmap_config_t config = i2c_regmap_get_default_config(mem, sizeof(mem));
+    config.prefill = true;
+    if (shadow) {
+        config.shadow = shadow_mem;
+    }
+    static i2c_regmap_t regmap;
+    i2c_regmap_init(&regmap, &config);
+    i2c_regmap_slave_init(i2c0, I2C_SLAVE_ADDRESS, &regmap);
+
+    const uint8_t address = 8;
+    CHECK(i2c_write_blocking(i2c1, I2C_SLAVE_ADDRESS, &address, 1, true) == 1);
+    uint8_t in[I2C_SLAVE_PREFILL_MAX + 8];
+    CHECK(i2c_read_blocking(i2c1, I2C_SLAVE_ADDRESS, in, sizeof(in), false) == (int)sizeof(in));
+    for (uint i = 0; i < sizeof(in); i++) {
+        CHECK(in[i] == address + i);
+    }
+
+    i2c_slave_stats_t stats;
+    i2c_slave_get_stats(i2c0, &stats);
+    i2c_slave_deinit(i2c0);
+    return stats.tx_prefills;
+}
+
+static void test_regmap_prefill() {
+    CHECK(run_prefill_read(false) == 1);
+    // the staged bytes and the rest of the read could come from different banks
+    CHECK(run_prefill_read(true) == 0);
+}
+
+//
+// main
+//
+
+struct Test
+{
+    const char *name;
+    void (*run)();
+};
+
+static const Test TESTS[] = {
+    {"request_only_callbacks", &test_request_only_callbacks},
+    {"pec_handler", &test_pec_handler},
+    {"pec_wire", &test_pec_wire},
+    {"wire_long_reply", &test_wire_long_reply},
+    {"wire_deferred_receive", &test_wire_deferred_receive},
+    {"regmap_prefill", &test_regmap_prefill},
+};
+
+int main() {
+    for (const Test &test : TESTS) {
+        uint before = failures;
+        i2c_init(i2c0, 100000);
+        i2c_init(i2c1, 100000);
+        test.run();
+        printf("%s %s\n", failures == before ? "pass" : "FAIL", test.name);
+    }
+    return failures == 0 ? 0 : 1;
+}
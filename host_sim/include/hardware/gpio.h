@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _HARDWARE_GPIO_H
+#define _HARDWARE_GPIO_H
+
+#include <pico.h>
+
+enum gpio_function
+{
+    GPIO_FUNC_I2C = 3,
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The simulated bus isn't wired through pins, so these do nothing.
+
+static inline void gpio_init(uint gpio) {
+    (void)gpio;
+}
+
+static inline void gpio_set_function(uint gpio, enum gpio_function fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+static inline void gpio_pull_up(uint gpio) {
+    (void)gpio;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _HARDWARE_GPIO_H
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _HARDWARE_I2C_H
+#define _HARDWARE_I2C_H
+
+#include <pico.h>
+#include <hardware/structs/i2c.h>
+
+#define IC_TX_BUFFER_DEPTH 16
+#define IC_RX_BUFFER_DEPTH 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct i2c_inst
+{
+    i2c_hw_t *hw;
+    bool restart_on_next;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+
+// Both instances sit on the same simulated bus. In master mode, the blocking calls below drive
+// whichever instance is in slave mode at the target address, see sim_i2c_master_write().
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+
+void i2c_deinit(i2c_inst_t *i2c);
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+
+void i2c_set_slave_mode(i2c_inst_t *i2c, bool slave, uint8_t addr);
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+// The simulated bus has no clock, so these time out only when the slave stretches for too long,
+// as the blocking calls do. See SIM_I2C_STRETCH_LIMIT.
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+    uint timeout_us);
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us);
+
+static inline uint i2c_hw_index(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+    return i2c == i2c1 ? 1 : 0;
+}
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) {
+    i2c_hw_index(i2c); // check it's a hardware I2C instance
+    return i2c->hw;
+}
+
+static inline i2c_inst_t *i2c_get_instance(uint num) {
+    assert(num <= 1);
+    return num ? i2c1 : i2c0;
+}
+
+static inline size_t i2c_get_write_available(i2c_inst_t *i2c) {
+    return IC_TX_BUFFER_DEPTH - i2c_get_hw(i2c)->txflr;
+}
+
+static inline size_t i2c_get_read_available(i2c_inst_t *i2c) {
+    return i2c_get_hw(i2c)->rxflr;
+}
+
+static inline uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    return 32 + 2 * i2c_hw_index(i2c) + (is_tx ? 0 : 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _HARDWARE_I2C_H
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _HARDWARE_IRQ_H
+#define _HARDWARE_IRQ_H
+
+#include <pico.h>
+
+#define I2C0_IRQ 23
+#define I2C1_IRQ 24
+#define NUM_IRQS 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*irq_handler_t)(void);
+
+// Handlers are called by the simulated peripherals whenever an enabled interrupt is pending.
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+
+void irq_remove_handler(uint num, irq_handler_t handler);
+
+irq_handler_t irq_get_exclusive_handler(uint num);
+
+void irq_set_enabled(uint num, bool enabled);
+
+bool irq_is_enabled(uint num);
+
+void irq_set_priority(uint num, uint8_t hardware_priority);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _HARDWARE_IRQ_H
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _HARDWARE_STRUCTS_I2C_H
+#define _HARDWARE_STRUCTS_I2C_H
+
+#include <pico.h>
+
+// DW_apb_i2c register block, laid out as on the RP2040. On the host, it's backed by the
+// simulator in sim_i2c.h, which traps every access.
+
+typedef struct
+{
+    io_rw_32 con;
+    io_rw_32 tar;
+    io_rw_32 sar;
+    uint32_t _pad0;
+    io_rw_32 data_cmd;
+    io_rw_32 ss_scl_hcnt;
+    io_rw_32 ss_scl_lcnt;
+    io_rw_32 fs_scl_hcnt;
+    io_rw_32 fs_scl_lcnt;
+    uint32_t _pad1[2];
+    io_ro_32 intr_stat;
+    io_rw_32 intr_mask;
+    io_ro_32 raw_intr_stat;
+    io_rw_32 rx_tl;
+    io_rw_32 tx_tl;
+    io_ro_32 clr_intr;
+    io_ro_32 clr_rx_under;
+    io_ro_32 clr_rx_over;
+    io_ro_32 clr_tx_over;
+    io_ro_32 clr_rd_req;
+    io_ro_32 clr_tx_abrt;
+    io_ro_32 clr_rx_done;
+    io_ro_32 clr_activity;
+    io_ro_32 clr_stop_det;
+    io_ro_32 clr_start_det;
+    io_ro_32 clr_gen_call;
+    io_rw_32 enable;
+    io_ro_32 status;
+    io_ro_32 txflr;
+    io_ro_32 rxflr;
+    io_rw_32 sda_hold;
+    io_ro_32 tx_abrt_source;
+    io_rw_32 slv_data_nack_only;
+    io_rw_32 dma_cr;
+    io_rw_32 dma_tdlr;
+    io_rw_32 dma_rdlr;
+    io_rw_32 sda_setup;
+    io_rw_32 ack_general_call;
+    io_ro_32 enable_status;
+    io_rw_32 fs_spklen;
+    uint32_t _pad2;
+    io_ro_32 clr_restart_det;
+} i2c_hw_t;
+
+#define I2C_IC_INTR_STAT_R_RESTART_DET_BITS 0x1000u
+#define I2C_IC_INTR_STAT_R_GEN_CALL_BITS 0x800u
+#define I2C_IC_INTR_STAT_R_START_DET_BITS 0x400u
+#define I2C_IC_INTR_STAT_R_STOP_DET_BITS 0x200u
+#define I2C_IC_INTR_STAT_R_ACTIVITY_BITS 0x100u
+#define I2C_IC_INTR_STAT_R_RX_DONE_BITS 0x80u
+#define I2C_IC_INTR_STAT_R_TX_ABRT_BITS 0x40u
+#define I2C_IC_INTR_STAT_R_RD_REQ_BITS 0x20u
+#define I2C_IC_INTR_STAT_R_TX_EMPTY_BITS 0x10u
+#define I2C_IC_INTR_STAT_R_TX_OVER_BITS 0x8u
+#define I2C_IC_INTR_STAT_R_RX_FULL_BITS 0x4u
+#define I2C_IC_INTR_STAT_R_RX_OVER_BITS 0x2u
+#define I2C_IC_INTR_STAT_R_RX_UNDER_BITS 0x1u
+#define I2C_IC_INTR_MASK_RESET 0x000008ffu
+#define I2C_IC_INTR_MASK_M_RESTART_DET_BITS 0x1000u
+#define I2C_IC_INTR_MASK_M_START_DET_BITS 0x400u
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS 0x200u
+#define I2C_IC_INTR_MASK_M_RX_DONE_BITS 0x80u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS 0x40u
+#define I2C_IC_INTR_MASK_M_RD_REQ_BITS 0x20u
+#define I2C_IC_INTR_MASK_M_TX_EMPTY_BITS 0x10u
+#define I2C_IC_INTR_MASK_M_RX_FULL_BITS 0x4u
+#define I2C_IC_INTR_MASK_M_RX_OVER_BITS 0x2u
+#define I2C_IC_RAW_INTR_STAT_START_DET_BITS 0x400u
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS 0x200u
+#define I2C_IC_RAW_INTR_STAT_RX_DONE_BITS 0x80u
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x40u
+#define I2C_IC_RAW_INTR_STAT_RD_REQ_BITS 0x20u
+#define I2C_IC_RAW_INTR_STAT_TX_EMPTY_BITS 0x10u
+#define I2C_IC_RAW_INTR_STAT_RX_FULL_BITS 0x4u
+#define I2C_IC_RAW_INTR_STAT_RX_OVER_BITS 0x2u
+#define I2C_IC_STATUS_RFF_BITS 0x10u
+#define I2C_IC_STATUS_RFNE_BITS 0x8u
+#define I2C_IC_STATUS_TFE_BITS 0x4u
+#define I2C_IC_STATUS_TFNF_BITS 0x2u
+#define I2C_IC_CON_RX_FIFO_FULL_HLD_CTRL_BITS 0x200u
+#define I2C_IC_CON_TX_EMPTY_CTRL_BITS 0x100u
+#define I2C_IC_CON_STOP_DET_IFADDRESSED_BITS 0x80u
+#define I2C_IC_CON_SPEED_BITS 0x6u
+#define I2C_IC_CON_SPEED_LSB 1
+#define I2C_IC_CON_SPEED_VALUE_FAST 2
+#define I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS 0x800u
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x400u
+#define I2C_IC_DATA_CMD_STOP_BITS 0x200u
+#define I2C_IC_DATA_CMD_CMD_BITS 0x100u
+#define I2C_IC_DATA_CMD_DAT_BITS 0xffu
+#define I2C_IC_DMA_CR_TDMAE_BITS 0x2u
+#define I2C_IC_DMA_CR_RDMAE_BITS 0x1u
+#define I2C_IC_SDA_HOLD_IC_SDA_TX_HOLD_BITS 0xffffu
+#define I2C_IC_SDA_HOLD_IC_SDA_TX_HOLD_LSB 0
+#define I2C_IC_SDA_HOLD_IC_SDA_RX_HOLD_BITS 0xff0000u
+#define I2C_IC_SDA_HOLD_IC_SDA_RX_HOLD_LSB 16
+#define I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_BITS 0xff800000u
+#define I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_LSB 23
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_SLVRD_INTX_BITS 0x8000u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_SLV_ARBLOST_BITS 0x4000u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_SLVFLUSH_TXFIFO_BITS 0x2000u
+#define I2C_IC_TX_ABRT_SOURCE_ARB_LOST_BITS 0x1000u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS 0x1u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS 0x8u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_SLVFLUSH_TXFIFO_LSB 13
+#define I2C_IC_FS_SPKLEN_BITS 0xffu
+#define I2C_IC_SDA_SETUP_BITS 0xffu
+
+#endif // _HARDWARE_STRUCTS_I2C_H
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _HARDWARE_STRUCTS_SIO_H
+#define _HARDWARE_STRUCTS_SIO_H
+
+#include <pico.h>
+
+#define SIO_FIFO_ST_VLD_BITS 0x00000001u
+#define SIO_FIFO_ST_RDY_BITS 0x00000002u
+
+typedef struct
+{
+    io_ro_32 cpuid;
+    io_ro_32 gpio_in;
+    uint32_t _pad0[18];
+    io_rw_32 fifo_st;
+    io_wo_32 fifo_wr;
+    io_ro_32 fifo_rd;
+} sio_hw_t;
+
+// Plain memory: the inter-core FIFO always reads ready, and pushed values are simply dropped.
+extern sio_hw_t *const sio_hw;
+
+#endif // _HARDWARE_STRUCTS_SIO_H
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _HARDWARE_STRUCTS_SYSTICK_H
+#define _HARDWARE_STRUCTS_SYSTICK_H
+
+#include <pico.h>
+
+#define M0PLUS_SYST_CSR_ENABLE_BITS 0x00000001u
+#define M0PLUS_SYST_CSR_CLKSOURCE_BITS 0x00000004u
+
+typedef struct
+{
+    io_rw_32 csr;
+    io_rw_32 rvr;
+    io_rw_32 cvr;
+    io_ro_32 calib;
+} systick_hw_t;
+
+// Plain memory, so profiling builds link but measure nothing. Use the host clock instead.
+extern systick_hw_t *const systick_hw;
+
+#endif // _HARDWARE_STRUCTS_SYSTICK_H
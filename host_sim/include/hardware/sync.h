@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include <hardware/address_mapped.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef volatile uint32_t spin_lock_t;
+
+// The simulated ISR runs synchronously from the scripted master, so there is nothing to mask.
+uint32_t save_and_disable_interrupts(void);
+
+void restore_interrupts(uint32_t status);
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+
+uint next_striped_spin_lock_num(void);
+
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _HARDWARE_SYNC_H
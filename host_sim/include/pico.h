@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _PICO_H
+#define _PICO_H
+
+// Host build: the subset of the Pico SDK used by the slave library, enough to run it against the
+// simulated I2C block in sim_i2c.h. Names and semantics follow the SDK.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+typedef volatile uint32_t io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+typedef volatile uint32_t io_wo_32;
+
+enum pico_error_codes
+{
+    PICO_OK = 0,
+    PICO_ERROR_NONE = 0,
+    PICO_ERROR_TIMEOUT = -1,
+    PICO_ERROR_GENERIC = -2,
+};
+
+// no flash on the host, so placement is left to the compiler
+#define __not_in_flash(group)
+#define __not_in_flash_func(func) func
+#define __time_critical_func(func) func
+#define __scratch_x(group)
+#define __scratch_y(group)
+#define __force_inline inline __attribute__((always_inline))
+#define __unused __attribute__((unused))
+#define __isr
+
+#ifndef MIN
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#define hard_assert assert
+
+#define PICO_DEFAULT_IRQ_PRIORITY 0x80
+#define PICO_DEFAULT_I2C_SDA_PIN 4
+#define PICO_DEFAULT_I2C_SCL_PIN 5
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void tight_loop_contents(void) {}
+
+static inline void __dmb(void) {
+    __sync_synchronize();
+}
+
+static inline void __sev(void) {}
+
+static inline void __wfe(void) {}
+
+static inline void __compiler_memory_barrier(void) {
+    __asm__ volatile("" ::: "memory");
+}
+
+// everything runs on a single host thread, which stands for core 0
+uint get_core_num(void);
+
+void panic(const char *fmt, ...) __attribute__((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PICO_H
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+#include <pico.h>
+#include <hardware/gpio.h>
+#include <hardware/i2c.h>
+#include <hardware/timer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// stdio goes straight to the host's stdout
+static inline bool stdio_init_all(void) {
+    return true;
+}
+
+void sleep_us(uint64_t us);
+
+void sleep_ms(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PICO_STDLIB_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _SIM_I2C_H_
+#define _SIM_I2C_H_
+
+#include <hardware/i2c.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file sim_i2c.h
+ *
+ * \brief Simulated DW_apb_i2c blocks, for running the slave library on a host.
+ *
+ * `i2c0` and `i2c1` point to register blocks which behave like the RP2040 ones in slave mode:
+ * 16 byte FIFOs with FIRST_DATA_BYTE, RX_FULL / TX_EMPTY thresholds, RD_REQ with clock
+ * stretching while the Tx FIFO is empty, Tx FIFO flush (TX_ABRT) on a new read, START_DET /
+ * STOP_DET / RESTART_DET, RX_OVER or bus hold when the Rx FIFO is full, and clear-on-read
+ * interrupt registers. Library code accesses them through `i2c_get_hw()` as usual, unchanged.
+ *
+ * Each register access is trapped: the block is mapped without permissions, and the fault
+ * handler applies the side effects of the access, then single-steps the instruction. This
+ * needs Linux on x86-64. It also makes a register access cost microseconds on the host, so ISR
+ * time is only counted while the ISR code runs, between traps, see `sim_i2c_stats_t`.
+ *
+ * A scripted master, `sim_i2c_master_write()` / `sim_i2c_master_read()`, drives transfers on
+ * the bus byte by byte. Between bytes, the I2C ISR installed with `irq_set_exclusive_handler()`
+ * is called for as long as an unmasked interrupt is pending, as if it ran instantly on the
+ * chip. The SDK calls `i2c_write_blocking()` / `i2c_read_blocking()` go through the same
+ * master, so code written against a second I2C instance as master works too.
+ *
+ * There is a single host thread, standing in for core 0. DMA is not simulated.
+ */
+
+/**
+ * \brief Number of ISR runs within a single bus event, after which the simulator gives up
+ * waiting for the ISR to clear an interrupt.
+ */
+#define SIM_I2C_ISR_LIMIT 64
+
+/**
+ * \brief Number of times the master waits on a stretched clock, before failing the transfer
+ * with PICO_ERROR_TIMEOUT.
+ */
+#define SIM_I2C_STRETCH_LIMIT 1000
+
+/**
+ * \brief Simulator counters for one I2C instance, see `sim_i2c_get_stats()`.
+ */
+typedef struct sim_i2c_stats_t
+{
+    uint64_t isr_calls; /**< Runs of the I2C ISR. */
+    uint64_t isr_ns; /**< Host time spent in the ISR, without the trap handlers. */
+    uint64_t isr_accesses; /**< Register accesses made from the ISR. */
+    uint64_t accesses; /**< All register accesses. */
+    uint32_t stretches; /**< Bytes read by master which found the Tx FIFO still empty after RD_REQ. */
+    /** Register accesses from raising RD_REQ until the first byte is in the Tx FIFO. On the chip,
+        this is roughly how long master is clock stretched. */
+    uint64_t stretch_accesses;
+    uint32_t rx_overflows; /**< Bytes dropped because the Rx FIFO was full (RX_OVER). */
+    uint32_t isr_storms; /**< Bus events where the ISR kept running without clearing its interrupt. */
+} sim_i2c_stats_t;
+
+/**
+ * \brief Called while master is waiting on a stretched clock, in thread context.
+ *
+ * Stands for the application's main loop, or the other core, for example to empty a queue and
+ * call `i2c_slave_resume_rx()`.
+ */
+typedef void (*sim_i2c_idle_handler_t)(void);
+
+/**
+ * \brief Write to a slave, as master.
+ *
+ * \param addr 7-bit slave address.
+ * \param src Data to write.
+ * \param len Number of bytes.
+ * \param nostop If true, keep the bus for a Restart instead of sending Stop.
+ * \return The number of bytes written, PICO_ERROR_GENERIC if no slave answered the address, or
+ *         PICO_ERROR_TIMEOUT if the slave held the bus for more than SIM_I2C_STRETCH_LIMIT.
+ */
+int sim_i2c_master_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+/**
+ * \brief Read from a slave, as master. The last byte is NACKed.
+ *
+ * \param addr 7-bit slave address.
+ * \param dst Receives the data.
+ * \param len Number of bytes.
+ * \param nostop If true, keep the bus for a Restart instead of sending Stop.
+ * \return The number of bytes read, or an error as for `sim_i2c_master_write()`.
+ */
+int sim_i2c_master_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+/**
+ * \brief Set the handler called while master is clock stretched.
+ *
+ * \param handler Idle handler, or NULL.
+ */
+void sim_i2c_set_idle_handler(sim_i2c_idle_handler_t handler);
+
+/**
+ * \brief Get a copy of the simulator counters.
+ *
+ * \param i2c I2C instance.
+ * \param stats Receives the counters.
+ */
+void sim_i2c_get_stats(i2c_inst_t *i2c, sim_i2c_stats_t *stats);
+
+/**
+ * \brief Clear the simulator counters.
+ *
+ * \param i2c I2C instance.
+ */
+void sim_i2c_reset_stats(i2c_inst_t *i2c);
+
+/**
+ * \brief Get the host time each trapped register access still adds to `isr_ns`, in ns.
+ *
+ * This is the kernel entering and leaving the trap handlers. Measured once, on first use.
+ * Subtract `isr_accesses` times this from `isr_ns`, for the time spent in the ISR code itself.
+ */
+double sim_i2c_access_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SIM_I2C_H_
@@ -0,0 +1,605 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define _GNU_SOURCE
+
+#include <sim_i2c.h>
+#include <hardware/irq.h>
+#include <hardware/timer.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if !defined(__linux__) || !defined(__x86_64__)
+#error "the I2C simulator traps register accesses, which is only implemented for Linux on x86-64"
+#endif
+
+#define PAGE_SIZE 4096
+#define TRAP_FLAG 0x100 // EFLAGS.TF, single-step
+#define PAGE_FAULT_WRITE 0x2 // page fault error code, the access was a write
+
+#define REG(field) offsetof(i2c_hw_t, field)
+
+// Interrupts latched until cleared by reading a clr_* register. RX_FULL and TX_EMPTY follow the
+// FIFO levels instead.
+#define LATCHED_INTR_BITS (I2C_IC_INTR_STAT_R_RESTART_DET_BITS | I2C_IC_INTR_STAT_R_GEN_CALL_BITS | I2C_IC_INTR_STAT_R_START_DET_BITS | I2C_IC_INTR_STAT_R_STOP_DET_BITS | I2C_IC_INTR_STAT_R_ACTIVITY_BITS | I2C_IC_INTR_STAT_R_RX_DONE_BITS | I2C_IC_INTR_STAT_R_TX_ABRT_BITS | I2C_IC_INTR_STAT_R_RD_REQ_BITS | I2C_IC_INTR_STAT_R_TX_OVER_BITS | I2C_IC_INTR_STAT_R_RX_OVER_BITS | I2C_IC_INTR_STAT_R_RX_UNDER_BITS)
+
+typedef struct sim_i2c_t
+{
+    uint index;
+    i2c_hw_t *regs; // simulator view of the register block, never trapped
+    void *page; // trapped view, which i2c_inst_t::hw points to
+    bool slave;
+    uint16_t rx_fifo[IC_RX_BUFFER_DEPTH]; // data, with FIRST_DATA_BYTE
+    uint rx_head;
+    uint rx_count;
+    uint8_t tx_fifo[IC_TX_BUFFER_DEPTH];
+    uint tx_head;
+    uint tx_count;
+    uint32_t raw; // latched interrupts
+    uint32_t abort_source;
+    bool first_data; // the next byte received is the first of the transfer
+    bool in_isr;
+    bool stretched; // RD_REQ raised, and the Tx FIFO still empty
+    sim_i2c_stats_t stats;
+} sim_i2c_t;
+
+static sim_i2c_t devices[2];
+
+i2c_inst_t i2c0_inst;
+i2c_inst_t i2c1_inst;
+
+static sim_i2c_idle_handler_t idle_handler;
+static volatile uint64_t resume_ns; // when the ISR last resumed after a trapped access
+static sim_i2c_t *held; // addressed by the last transfer, which ended without Stop
+
+// the access being single-stepped
+static struct
+{
+    sim_i2c_t *dev;
+    uint offset;
+    bool write;
+} trapped;
+
+//
+// register model
+//
+
+static inline void set_reg(sim_i2c_t *dev, uint offset, uint32_t value) {
+    ((volatile uint32_t *)dev->regs)[offset / 4] = value;
+}
+
+static inline uint32_t get_reg(const sim_i2c_t *dev, uint offset) {
+    return ((const volatile uint32_t *)dev->regs)[offset / 4];
+}
+
+static void flush_fifos(sim_i2c_t *dev) {
+    dev->rx_head = 0;
+    dev->rx_count = 0;
+    dev->tx_head = 0;
+    dev->tx_count = 0;
+}
+
+static uint32_t raw_intr(const sim_i2c_t *dev) {
+    uint32_t raw = dev->raw;
+    if (dev->rx_count > dev->regs->rx_tl) {
+        raw |= I2C_IC_INTR_STAT_R_RX_FULL_BITS;
+    }
+    if (dev->tx_count <= dev->regs->tx_tl) {
+        raw |= I2C_IC_INTR_STAT_R_TX_EMPTY_BITS;
+    }
+    return raw;
+}
+
+static inline uint32_t pending_intr(const sim_i2c_t *dev) {
+    return raw_intr(dev) & dev->regs->intr_mask;
+}
+
+static uint32_t clear_intr(sim_i2c_t *dev, uint32_t bits) {
+    if (bits & dev->raw & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        dev->abort_source = 0;
+    }
+    dev->raw &= ~bits;
+    return 0;
+}
+
+static uint32_t pop_rx(sim_i2c_t *dev) {
+    if (dev->rx_count == 0) {
+        dev->raw |= I2C_IC_INTR_STAT_R_RX_UNDER_BITS;
+        return 0;
+    }
+    uint32_t value = dev->rx_fifo[dev->rx_head];
+    dev->rx_head = (dev->rx_head + 1) % IC_RX_BUFFER_DEPTH;
+    dev->rx_count--;
+    return value;
+}
+
+static void push_tx(sim_i2c_t *dev, uint8_t value) {
+    if (dev->tx_count == IC_TX_BUFFER_DEPTH) {
+        dev->raw |= I2C_IC_INTR_STAT_R_TX_OVER_BITS;
+        return;
+    }
+    dev->tx_fifo[(dev->tx_head + dev->tx_count) % IC_TX_BUFFER_DEPTH] = value;
+    dev->tx_count++;
+    dev->stretched = false;
+}
+
+static uint32_t status(const sim_i2c_t *dev) {
+    uint32_t value = 0;
+    if (dev->rx_count == IC_RX_BUFFER_DEPTH) {
+        value |= I2C_IC_STATUS_RFF_BITS;
+    }
+    if (dev->rx_count != 0) {
+        value |= I2C_IC_STATUS_RFNE_BITS;
+    }
+    if (dev->tx_count == 0) {
+        value |= I2C_IC_STATUS_TFE_BITS;
+    }
+    if (dev->tx_count != IC_TX_BUFFER_DEPTH) {
+        value |= I2C_IC_STATUS_TFNF_BITS;
+    }
+    return value;
+}
+
+// Computes the value about to be read, and applies the side effects of reading it.
+static void before_read(sim_i2c_t *dev, uint offset) {
+    switch (offset) {
+    case REG(data_cmd):
+        set_reg(dev, offset, pop_rx(dev));
+        break;
+    case REG(intr_stat):
+        set_reg(dev, offset, pending_intr(dev));
+        break;
+    case REG(raw_intr_stat):
+        set_reg(dev, offset, raw_intr(dev));
+        break;
+    case REG(clr_intr):
+        set_reg(dev, offset, clear_intr(dev, LATCHED_INTR_BITS));
+        break;
+    case REG(clr_rx_under):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_RX_UNDER_BITS));
+        break;
+    case REG(clr_rx_over):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_RX_OVER_BITS));
+        break;
+    case REG(clr_tx_over):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_TX_OVER_BITS));
+        break;
+    case REG(clr_rd_req):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_RD_REQ_BITS));
+        break;
+    case REG(clr_tx_abrt):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_TX_ABRT_BITS));
+        break;
+    case REG(clr_rx_done):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_RX_DONE_BITS));
+        break;
+    case REG(clr_activity):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_ACTIVITY_BITS));
+        break;
+    case REG(clr_stop_det):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_STOP_DET_BITS));
+        break;
+    case REG(clr_start_det):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_START_DET_BITS));
+        break;
+    case REG(clr_gen_call):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_GEN_CALL_BITS));
+        break;
+    case REG(clr_restart_det):
+        set_reg(dev, offset, clear_intr(dev, I2C_IC_INTR_STAT_R_RESTART_DET_BITS));
+        break;
+    case REG(status):
+        set_reg(dev, offset, status(dev));
+        break;
+    case REG(txflr):
+        set_reg(dev, offset, dev->tx_count);
+        break;
+    case REG(rxflr):
+        set_reg(dev, offset, dev->rx_count);
+        break;
+    case REG(tx_abrt_source):
+        set_reg(dev, offset, dev->abort_source);
+        break;
+    case REG(enable_status):
+        set_reg(dev, offset, get_reg(dev, REG(enable)) & 1);
+        break;
+    default:
+        break; // plain storage
+    }
+}
+
+// Applies the side effects of a value just written.
+static void after_write(sim_i2c_t *dev, uint offset) {
+    switch (offset) {
+    case REG(data_cmd):
+        push_tx(dev, (uint8_t)get_reg(dev, offset));
+        break;
+    case REG(enable):
+        if ((get_reg(dev, offset) & 1) == 0) {
+            flush_fifos(dev); // as when disabling DW_apb_i2c
+        }
+        break;
+    default:
+        break; // plain storage
+    }
+}
+
+static void reset_device(sim_i2c_t *dev) {
+    memset(dev->regs, 0, sizeof(i2c_hw_t));
+    set_reg(dev, REG(intr_mask), I2C_IC_INTR_MASK_RESET);
+    set_reg(dev, REG(sda_hold), 1);
+    set_reg(dev, REG(sda_setup), 0x64);
+    set_reg(dev, REG(fs_spklen), 7);
+    dev->slave = false;
+    flush_fifos(dev);
+    dev->raw = 0;
+    dev->abort_source = 0;
+    dev->first_data = false;
+    dev->stretched = false;
+}
+
+//
+// access trapping
+//
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static sim_i2c_t *find_device(uintptr_t addr) {
+    for (uint i = 0; i < count_of(devices); i++) {
+        uintptr_t page = (uintptr_t)devices[i].page;
+        if (page <= addr && addr < page + PAGE_SIZE) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+static void on_segv(int sig, siginfo_t *info, void *context) {
+    (void)sig;
+    ucontext_t *uc = (ucontext_t *)context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    sim_i2c_t *dev = find_device(addr);
+    if (dev == NULL || trapped.dev != NULL) {
+        // a genuine crash, fault again with the default action
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+    if (dev->in_isr) {
+        dev->stats.isr_ns += now_ns() - resume_ns;
+    }
+    uint offset = (uint)(addr - (uintptr_t)dev->page) & ~3u;
+    bool write = (uc->uc_mcontext.gregs[REG_ERR] & PAGE_FAULT_WRITE) != 0;
+    if (!write) {
+        before_read(dev, offset);
+    }
+    dev->stats.accesses++;
+    if (dev->in_isr) {
+        dev->stats.isr_accesses++;
+    }
+    if (dev->stretched) {
+        dev->stats.stretch_accesses++;
+    }
+    trapped.dev = dev;
+    trapped.offset = offset;
+    trapped.write = write;
+    mprotect(dev->page, PAGE_SIZE, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+}
+
+static void on_trap(int sig, siginfo_t *info, void *context) {
+    (void)sig;
+    (void)info;
+    ucontext_t *uc = (ucontext_t *)context;
+    sim_i2c_t *dev = trapped.dev;
+    if (dev == NULL) {
+        signal(SIGTRAP, SIG_DFL);
+        return;
+    }
+    uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+    mprotect(dev->page, PAGE_SIZE, PROT_NONE);
+    trapped.dev = NULL;
+    if (trapped.write) {
+        after_write(dev, trapped.offset);
+    }
+    if (dev->in_isr) {
+        resume_ns = now_ns();
+    }
+}
+
+static void map_device(sim_i2c_t *dev, uint index) {
+    // the same memory twice, so the simulator can update registers without trapping itself
+    int fd = memfd_create("sim_i2c", 0);
+    if (fd < 0 || ftruncate(fd, PAGE_SIZE) != 0) {
+        panic("sim_i2c: can't create register memory");
+    }
+    void *regs = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    void *page = mmap(NULL, PAGE_SIZE, PROT_NONE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (regs == MAP_FAILED || page == MAP_FAILED) {
+        panic("sim_i2c: can't map register memory");
+    }
+    dev->index = index;
+    dev->regs = (i2c_hw_t *)regs;
+    dev->page = page;
+    reset_device(dev);
+}
+
+__attribute__((constructor)) static void sim_i2c_setup(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    action.sa_sigaction = on_segv;
+    sigaction(SIGSEGV, &action, NULL);
+    action.sa_sigaction = on_trap;
+    sigaction(SIGTRAP, &action, NULL);
+
+    map_device(&devices[0], 0);
+    map_device(&devices[1], 1);
+    i2c0_inst.hw = (i2c_hw_t *)devices[0].page;
+    i2c1_inst.hw = (i2c_hw_t *)devices[1].page;
+}
+
+static inline sim_i2c_t *get_device(i2c_inst_t *i2c) {
+    return &devices[i2c_hw_index(i2c)];
+}
+
+//
+// bus
+//
+
+// Runs the ISR for as long as it has something to do, as if it took no time on the bus.
+static void deliver(sim_i2c_t *dev) {
+    uint num = I2C0_IRQ + dev->index;
+    for (uint i = 0; pending_intr(dev) != 0; i++) {
+        irq_handler_t handler = irq_get_exclusive_handler(num);
+        if (handler == NULL || !irq_is_enabled(num)) {
+            return; // left pending, as while masked on the chip
+        }
+        if (i == SIM_I2C_ISR_LIMIT) {
+            dev->stats.isr_storms++;
+            return;
+        }
+        dev->in_isr = true;
+        resume_ns = now_ns();
+        handler();
+        dev->stats.isr_ns += now_ns() - resume_ns;
+        dev->in_isr = false;
+        dev->stats.isr_calls++;
+    }
+}
+
+static bool stretch(sim_i2c_t *dev, uint wait) {
+    if (wait == SIM_I2C_STRETCH_LIMIT) {
+        return false;
+    }
+    if (idle_handler != NULL) {
+        idle_handler();
+    }
+    deliver(dev);
+    return true;
+}
+
+static void bus_condition(uint32_t bits, sim_i2c_t *target) {
+    // every slave sees Start / Stop on the bus, whether it's addressed or not
+    for (uint i = 0; i < count_of(devices); i++) {
+        sim_i2c_t *dev = &devices[i];
+        if (dev->slave) {
+            dev->raw |= bits;
+            if (dev == target && target == held && (bits & I2C_IC_INTR_STAT_R_START_DET_BITS)) {
+                dev->raw |= I2C_IC_INTR_STAT_R_RESTART_DET_BITS;
+            }
+            deliver(dev);
+        }
+    }
+}
+
+static sim_i2c_t *begin(uint8_t addr, bool is_read) {
+    sim_i2c_t *target = NULL;
+    for (uint i = 0; i < count_of(devices); i++) {
+        sim_i2c_t *dev = &devices[i];
+        if (dev->slave && (dev->regs->enable & 1) && dev->regs->sar == addr) {
+            target = dev;
+        }
+    }
+    bus_condition(I2C_IC_INTR_STAT_R_START_DET_BITS, target);
+    held = NULL;
+    if (target == NULL) {
+        return NULL; // address NACK
+    }
+    target->first_data = !is_read;
+    if (is_read && target->tx_count != 0) {
+        // data left over from the previous read is flushed, and reported as an abort
+        target->abort_source = I2C_IC_TX_ABRT_SOURCE_ABRT_SLVFLUSH_TXFIFO_BITS | (target->tx_count << I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_LSB);
+        target->tx_count = 0;
+        target->raw |= I2C_IC_INTR_STAT_R_TX_ABRT_BITS;
+        deliver(target);
+    }
+    return target;
+}
+
+static int end(sim_i2c_t *dev, int result, bool nostop) {
+    if (dev != NULL) {
+        dev->stretched = false; // timed out
+    }
+    if (nostop && result >= 0) {
+        held = dev;
+    } else {
+        bus_condition(I2C_IC_INTR_STAT_R_STOP_DET_BITS, NULL);
+    }
+    return result;
+}
+
+static bool receive_byte(sim_i2c_t *dev, uint8_t value) {
+    for (uint wait = 0; dev->rx_count == IC_RX_BUFFER_DEPTH; wait++) {
+        if (!(dev->regs->con & I2C_IC_CON_RX_FIFO_FULL_HLD_CTRL_BITS)) {
+            dev->raw |= I2C_IC_INTR_STAT_R_RX_OVER_BITS;
+            dev->stats.rx_overflows++;
+            deliver(dev);
+            return true; // ACKed and dropped
+        }
+        if (!stretch(dev, wait)) {
+            return false;
+        }
+    }
+    uint16_t entry = value;
+    if (dev->first_data) {
+        entry |= I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS;
+        dev->first_data = false;
+    }
+    dev->rx_fifo[(dev->rx_head + dev->rx_count) % IC_RX_BUFFER_DEPTH] = entry;
+    dev->rx_count++;
+    deliver(dev);
+    return true;
+}
+
+static bool send_byte(sim_i2c_t *dev, uint8_t *value, bool last) {
+    if (dev->tx_count == 0) {
+        dev->raw |= I2C_IC_INTR_STAT_R_RD_REQ_BITS;
+        dev->stretched = true;
+        deliver(dev);
+        for (uint wait = 0; dev->tx_count == 0; wait++) {
+            if (wait == 0) {
+                dev->stats.stretches++;
+            }
+            if (!stretch(dev, wait)) {
+                return false;
+            }
+        }
+    }
+    *value = dev->tx_fifo[dev->tx_head];
+    dev->tx_head = (dev->tx_head + 1) % IC_TX_BUFFER_DEPTH;
+    dev->tx_count--;
+    if (last) {
+        dev->raw |= I2C_IC_INTR_STAT_R_RX_DONE_BITS; // master NACKs the last byte
+    }
+    deliver(dev);
+    return true;
+}
+
+int sim_i2c_master_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    sim_i2c_t *dev = begin(addr, false);
+    if (dev == NULL) {
+        return end(NULL, PICO_ERROR_GENERIC, false);
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!receive_byte(dev, src[i])) {
+            return end(dev, PICO_ERROR_TIMEOUT, false);
+        }
+    }
+    return end(dev, (int)len, nostop);
+}
+
+int sim_i2c_master_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    sim_i2c_t *dev = begin(addr, true);
+    if (dev == NULL) {
+        return end(NULL, PICO_ERROR_GENERIC, false);
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!send_byte(dev, &dst[i], i + 1 == len)) {
+            return end(dev, PICO_ERROR_TIMEOUT, false);
+        }
+    }
+    return end(dev, (int)len, nostop);
+}
+
+void sim_i2c_set_idle_handler(sim_i2c_idle_handler_t handler) {
+    idle_handler = handler;
+}
+
+void sim_i2c_get_stats(i2c_inst_t *i2c, sim_i2c_stats_t *stats) {
+    *stats = get_device(i2c)->stats;
+}
+
+void sim_i2c_reset_stats(i2c_inst_t *i2c) {
+    memset(&get_device(i2c)->stats, 0, sizeof(sim_i2c_stats_t));
+}
+
+double sim_i2c_access_ns(void) {
+    static double access_ns = -1;
+    if (access_ns < 0) {
+        // what's left of a trap in isr_ns, the kernel entering and leaving the signal handlers
+        const int n = 10000;
+        sim_i2c_t *dev = &devices[0];
+        sim_i2c_stats_t saved = dev->stats;
+        i2c_hw_t *hw = (i2c_hw_t *)dev->page;
+        dev->stats.isr_ns = 0;
+        dev->in_isr = true;
+        resume_ns = now_ns();
+        // the signal handlers update isr_ns behind the compiler's back
+        __compiler_memory_barrier();
+        for (int i = 0; i < n; i++) {
+            (void)hw->enable_status;
+        }
+        __compiler_memory_barrier();
+        dev->stats.isr_ns += now_ns() - resume_ns;
+        dev->in_isr = false;
+        access_ns = (double)dev->stats.isr_ns / n;
+        dev->stats = saved;
+    }
+    return access_ns;
+}
+
+//
+// SDK I2C API
+//
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    sim_i2c_t *dev = get_device(i2c);
+    reset_device(dev);
+    set_reg(dev, REG(enable), 1);
+    return baudrate;
+}
+
+void i2c_deinit(i2c_inst_t *i2c) {
+    reset_device(get_device(i2c));
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+    (void)i2c;
+    return baudrate; // the simulated bus has no timing
+}
+
+void i2c_set_slave_mode(i2c_inst_t *i2c, bool slave, uint8_t addr) {
+    sim_i2c_t *dev = get_device(i2c);
+    // the SDK disables the block around this, which flushes the FIFOs
+    flush_fifos(dev);
+    dev->slave = slave;
+    set_reg(dev, REG(sar), addr);
+    set_reg(dev, REG(enable), 1);
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    assert(!get_device(i2c)->slave);
+    (void)i2c;
+    return sim_i2c_master_write(addr, src, len, nostop);
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    assert(!get_device(i2c)->slave);
+    (void)i2c;
+    return sim_i2c_master_read(addr, dst, len, nostop);
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+    uint timeout_us) {
+    (void)timeout_us;
+    return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us) {
+    (void)timeout_us;
+    return i2c_read_blocking(i2c, addr, dst, len, nostop);
+}
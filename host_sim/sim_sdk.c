@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The rest of the SDK subset in include/, on top of the host OS. There are no other threads, so
+// interrupts can't preempt anything, and locking reduces to bookkeeping.
+
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/structs/sio.h>
+#include <hardware/structs/systick.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include <pico/stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_SPIN_LOCKS 32
+#define FIRST_STRIPED_SPIN_LOCK 16
+
+static sio_hw_t sio_regs = {
+    .fifo_st = SIO_FIFO_ST_RDY_BITS,
+};
+static systick_hw_t systick_regs;
+static dma_hw_t dma_regs;
+
+sio_hw_t *const sio_hw = &sio_regs;
+systick_hw_t *const systick_hw = &systick_regs;
+dma_hw_t *const dma_hw = &dma_regs;
+
+static struct
+{
+    irq_handler_t handler;
+    bool enabled;
+    uint8_t priority;
+} irqs[NUM_IRQS];
+
+static spin_lock_t spin_locks[NUM_SPIN_LOCKS];
+
+uint get_core_num(void) {
+    return 0;
+}
+
+void panic(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fputs("*** PANIC ***\n", stderr);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    abort();
+}
+
+//
+// irq
+//
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    assert(num < NUM_IRQS);
+    if (irqs[num].handler != NULL && irqs[num].handler != handler) {
+        panic("irq %u already has a handler", num);
+    }
+    irqs[num].handler = handler;
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler) {
+    assert(num < NUM_IRQS);
+    if (irqs[num].handler == handler) {
+        irqs[num].handler = NULL;
+    }
+}
+
+irq_handler_t irq_get_exclusive_handler(uint num) {
+    assert(num < NUM_IRQS);
+    return irqs[num].handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    assert(num < NUM_IRQS);
+    irqs[num].enabled = enabled;
+}
+
+bool irq_is_enabled(uint num) {
+    assert(num < NUM_IRQS);
+    return irqs[num].enabled;
+}
+
+void irq_set_priority(uint num, uint8_t hardware_priority) {
+    assert(num < NUM_IRQS);
+    irqs[num].priority = hardware_priority;
+}
+
+//
+// sync
+//
+
+uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+void restore_interrupts(uint32_t status) {
+    (void)status;
+}
+
+spin_lock_t *spin_lock_instance(uint lock_num) {
+    assert(lock_num < NUM_SPIN_LOCKS);
+    return &spin_locks[lock_num];
+}
+
+uint next_striped_spin_lock_num(void) {
+    static uint next = FIRST_STRIPED_SPIN_LOCK;
+    uint lock_num = next;
+    next = next + 1 < NUM_SPIN_LOCKS ? next + 1 : FIRST_STRIPED_SPIN_LOCK;
+    return lock_num;
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock) {
+    // nothing else runs, so finding the lock taken means it was never released
+    if (*lock) {
+        panic("spin lock %p taken twice", (void *)lock);
+    }
+    *lock = 1;
+    return 0;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+    (void)saved_irq;
+    *lock = 0;
+}
+
+//
+// time
+//
+
+uint64_t time_us_64(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void sleep_us(uint64_t us) {
+    struct timespec ts = {
+        .tv_sec = (time_t)(us / 1000000u),
+        .tv_nsec = (long)(us % 1000000u) * 1000,
+    };
+    nanosleep(&ts, NULL);
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_us((uint64_t)ms * 1000u);
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    (void)clk_index;
+    return 125000000u; // reported only, nothing is clocked
+}
+
+//
+// dma
+//
+
+int dma_claim_unused_channel(bool required) {
+    if (required) {
+        panic("DMA is not simulated");
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    (void)channel;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+    const volatile void *read_addr, uint transfer_count, bool trigger) {
+    (void)channel;
+    (void)config;
+    (void)write_addr;
+    (void)read_addr;
+    (void)transfer_count;
+    (void)trigger;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+    (void)channel;
+    (void)read_addr;
+    (void)trigger;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {
+    (void)channel;
+    (void)write_addr;
+    (void)trigger;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+    (void)channel;
+    (void)trans_count;
+    (void)trigger;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+    (void)channel;
+    (void)read_addr;
+    (void)transfer_count;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr, uint32_t transfer_count) {
+    (void)channel;
+    (void)write_addr;
+    (void)transfer_count;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_abort(uint channel) {
+    (void)channel;
+    panic("DMA is not simulated");
+}
+
+bool dma_channel_is_busy(uint channel) {
+    (void)channel;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    (void)channel;
+    (void)enabled;
+    panic("DMA is not simulated");
+}
+
+void dma_channel_acknowledge_irq0(uint channel) {
+    (void)channel;
+    panic("DMA is not simulated");
+}
+
+bool dma_channel_get_irq0_status(uint channel) {
+    (void)channel;
+    panic("DMA is not simulated");
+}
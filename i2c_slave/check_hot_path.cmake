@@ -0,0 +1,46 @@
+# Fails if the slave ISR entry points were linked into flash, see i2c_slave_check_hot_path() in
+# CMakeLists.txt. Run with -DMAP_FILE=<GNU ld map file>.
+#
+# With -ffunction-sections (as in the Pico SDK), each function gets its own input section: ones
+# placed with I2C_SLAVE_HOT() are named after the group (.time_critical.*, .scratch_x.*, ...),
+# the rest after the function (.text.<symbol>). So a kept .text section named after one of the
+# entry points, or after a member meant to be inlined into one, means it runs from flash. GCC
+# silently drops section attributes on template members, which is how this regresses.
+
+if(NOT DEFINED MAP_FILE)
+    message(FATAL_ERROR "MAP_FILE not set")
+endif()
+
+file(READ "${MAP_FILE}" map)
+
+# skip the list of sections removed by --gc-sections
+string(FIND "${map}" "Linker script and memory map" start)
+if(start EQUAL -1)
+    message(FATAL_ERROR "${MAP_FILE}: not a GNU ld map file")
+endif()
+string(SUBSTRING "${map}" ${start} -1 map)
+
+set(hot_symbols
+    # C ISRs and entry points called from them
+    "i2c_slave_irq_handler"
+    "i2c[01]_slave_irq_handler"
+    "i2c_slave_read"
+    "i2c_slave_write"
+    "i2c_regmap_handler"
+    "pio[01]_irq_handler"
+    # I2cSlave, defined with I2C_SLAVE_DEFINE_IRQ_HANDLER()
+    "i2c[01]_slave_template_irq_handler"
+    "_ZN8I2cSlaveI[^ \n]*9handleIrqEv"
+    # Wire, defined with WIRE_DEFINE_INSTANCE(); the fallback entry points are meant for flash
+    "_ZL[0-9]+[A-Za-z0-9_]*_slave_handlerP8i2c_inst17i2c_slave_event_t"
+    "_ZL[0-9]+[A-Za-z0-9_]*_master_irq_handlerv"
+    "_ZN12BasicTwoWire[^ \n]*EE(16handleSlaveEvent|12serviceAsync|13handleReceive|13handleRequest|12handleFinish|15receiveDeferred|14finishDeferred|15discardReceived|10sendQueued|11finishAsync)E[^ \n]*"
+)
+list(JOIN hot_symbols "|" pattern)
+
+string(REGEX MATCHALL "\n \\.text\\.(${pattern})[ \n]" found "${map}")
+if(found)
+    string(REPLACE "\n" "" found "${found}")
+    string(REPLACE ";" "\n" found "${found}")
+    message(FATAL_ERROR "${MAP_FILE}: slave hot path linked into flash:\n${found}")
+endif()
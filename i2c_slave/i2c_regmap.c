@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <i2c_regmap.h>
+#include <i2c_fifo.h>
+#include <hardware/sync.h>
+#include <string.h>
+
+#define NO_BANK 0xff
+
+static I2C_SLAVE_HOT_DATA("i2c_regmap") i2c_regmap_t *i2c_regmaps[2];
+
+static inline uint8_t *bank_mem(const i2c_regmap_t *regmap, uint bank) {
+    return bank == 0 ? regmap->config.mem : regmap->config.shadow;
+}
+
+static inline void pin_bank(i2c_regmap_t *regmap) {
+    // The application may publish the other bank at any time. Re-check after pinning, so
+    // i2c_regmap_begin_update() either sees the bank pinned, or we see the bank it published.
+    uint8_t front;
+    do {
+        front = regmap->front;
+        regmap->pinned = front;
+        __dmb();
+    } while (regmap->front != front);
+    regmap->mem = bank_mem(regmap, front);
+}
+
+static inline bool is_writable(const i2c_regmap_t *regmap, uint32_t reg) {
+    for (uint i = 0; i < regmap->config.num_ranges; i++) {
+        const i2c_regmap_range_t *range = &regmap->config.ranges[i];
+        if (reg - range->start < range->size && (range->flags & I2C_REGMAP_READ_ONLY)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline void advance(i2c_regmap_t *regmap) {
+    regmap->address++;
+    if (regmap->address == regmap->config.size && regmap->config.wrap) {
+        regmap->address = 0;
+    }
+}
+
+static inline void rewind(i2c_regmap_t *regmap, uint count) {
+    if (regmap->config.wrap) {
+        count %= regmap->config.size;
+        if (regmap->address >= count) {
+            regmap->address -= count;
+        } else {
+            regmap->address += regmap->config.size - count;
+        }
+    } else {
+        regmap->address -= count;
+    }
+}
+
+static inline void load_latch(i2c_regmap_t *regmap, uint32_t base) {
+    const uint8_t *src = regmap->mem + base;
+    uint32_t *latch = (uint32_t *)regmap->latch;
+    switch (regmap->config.register_width) {
+    case 2:
+        *(uint16_t *)latch = *(const volatile uint16_t *)src;
+        break;
+    case 4:
+        latch[0] = *(const volatile uint32_t *)src;
+        break;
+    default:
+        latch[0] = ((const volatile uint32_t *)src)[0];
+        latch[1] = ((const volatile uint32_t *)src)[1];
+        break;
+    }
+    regmap->latch_address = base;
+    regmap->latch_valid = true;
+}
+
+static inline void store_latch(i2c_regmap_t *regmap) {
+    uint8_t *dst = regmap->mem + regmap->latch_address;
+    const uint32_t *latch = (const uint32_t *)regmap->latch;
+    switch (regmap->config.register_width) {
+    case 2:
+        *(volatile uint16_t *)dst = *(const uint16_t *)latch;
+        break;
+    case 4:
+        *(volatile uint32_t *)dst = latch[0];
+        break;
+    default:
+        ((volatile uint32_t *)dst)[0] = latch[0];
+        ((volatile uint32_t *)dst)[1] = latch[1];
+        break;
+    }
+}
+
+static inline void record_write(i2c_regmap_t *regmap, uint32_t base) {
+    if (regmap->config.dirty == NULL && !regmap->has_write_hooks) {
+        return;
+    }
+    // Registers written in one transaction form a contiguous span, since the address
+    // auto-increments. Read-only registers inside it are filtered out on finish.
+    if (regmap->write_bytes == 0) {
+        regmap->write_start = base;
+    }
+    regmap->write_bytes += regmap->config.register_width;
+    uint32_t offset = base >= regmap->write_start ? base - regmap->write_start : base + regmap->config.size - regmap->write_start;
+    regmap->write_span = offset + regmap->config.register_width;
+}
+
+static void I2C_SLAVE_HOT_FUNC(mark_written)(i2c_regmap_t *regmap, uint32_t start, uint32_t count) {
+    uint32_t width = regmap->config.register_width;
+    if (regmap->config.dirty != NULL) {
+        uint32_t bit = start / width;
+        uint32_t end_bit = (start + count) / width;
+        while (bit < end_bit) {
+            // build each word outside the lock, so it's only held for the update
+            uint32_t word = bit / 32;
+            uint32_t mask = 0;
+            for (; bit < end_bit && bit / 32 == word; bit++) {
+                if (is_writable(regmap, bit * width)) {
+                    mask |= 1u << (bit % 32);
+                }
+            }
+            if (mask != 0) {
+                uint32_t save = spin_lock_blocking(regmap->dirty_lock);
+                regmap->config.dirty[word] |= mask;
+                spin_unlock(regmap->dirty_lock, save);
+            }
+        }
+    }
+    for (uint i = 0; i < regmap->config.num_ranges && regmap->has_write_hooks; i++) {
+        const i2c_regmap_range_t *range = &regmap->config.ranges[i];
+        if (range->on_write == NULL || (range->flags & I2C_REGMAP_READ_ONLY)) {
+            continue;
+        }
+        uint32_t first = MAX(start, range->start);
+        uint32_t end = MIN(start + count, range->start + range->size);
+        if (first < end) {
+            range->on_write(regmap, first, end - first);
+        }
+    }
+}
+
+static inline void finish_writes(i2c_regmap_t *regmap) {
+    if (regmap->write_bytes == 0) {
+        return;
+    }
+    uint32_t size = regmap->config.size;
+    uint32_t start = regmap->write_start;
+    // may have wrapped around the whole map
+    uint32_t count = regmap->write_bytes >= size ? size : regmap->write_span;
+    if (count == size) {
+        start = 0;
+    }
+    uint32_t first = MIN(count, size - start);
+    mark_written(regmap, start, first);
+    if (first < count) {
+        mark_written(regmap, 0, count - first);
+    }
+    regmap->write_bytes = 0;
+}
+
+static inline uint8_t read_register(i2c_regmap_t *regmap) {
+    uint32_t reg = regmap->address;
+    if (reg >= regmap->config.size) {
+        return 0xff; // past the end
+    }
+    uint32_t width = regmap->config.register_width;
+    if (width == 1) {
+        return regmap->mem[reg];
+    }
+    uint32_t base = reg & ~(width - 1);
+    if (!regmap->latch_valid || regmap->latch_address != base) {
+        load_latch(regmap, base);
+    }
+    return regmap->latch[reg - base];
+}
+
+static inline void write_register(i2c_regmap_t *regmap, uint8_t value) {
+    uint32_t reg = regmap->address;
+    if (reg >= regmap->config.size) {
+        return; // past the end
+    }
+    uint32_t width = regmap->config.register_width;
+    if (width == 1) {
+        if (is_writable(regmap, reg)) {
+            regmap->mem[reg] = value;
+            record_write(regmap, reg);
+        }
+        return;
+    }
+    uint32_t base = reg & ~(width - 1);
+    if (!regmap->latch_valid || regmap->latch_address != base) {
+        // start from the current value, in case the write doesn't begin on the first byte
+        load_latch(regmap, base);
+    }
+    regmap->latch[reg - base] = value;
+    if (reg - base == width - 1 && is_writable(regmap, base)) {
+        store_latch(regmap);
+        record_write(regmap, base);
+    }
+}
+
+static inline void select_stream(i2c_regmap_t *regmap) {
+    regmap->stream = NULL;
+    for (uint i = 0; i < regmap->config.num_streams; i++) {
+        if (regmap->config.streams[i].reg == regmap->address) {
+            regmap->stream = &regmap->config.streams[i];
+            break;
+        }
+    }
+}
+
+static inline void stream_receive(i2c_regmap_stream_t *stream, const uint8_t *data, size_t count) {
+    if (stream->master_reads) {
+        return; // not writable
+    }
+    uint32_t head = stream->head;
+    uint32_t free = stream->mask + 1 - (head - stream->tail);
+    if (count > free) {
+        stream->overruns = stream->overruns + (count - free);
+        count = free;
+    }
+    for (size_t i = 0; i < count; i++) {
+        stream->buf[(head + i) & stream->mask] = data[i];
+    }
+    __dmb(); // fill the ring before publishing
+    stream->head = head + count;
+}
+
+static inline void stream_send(i2c_regmap_stream_t *stream, i2c_inst_t *i2c, bool must_write) {
+    size_t count = 0;
+    if (stream->master_reads) {
+        count = MIN(stream->head - stream->read_pos, (uint32_t)i2c_get_write_available(i2c));
+        __dmb(); // read the ring after seeing the head update
+    }
+    for (size_t left = count; left > 0;) {
+        // up to two bursts, when wrapping around the end of the ring
+        uint32_t offset = stream->read_pos & stream->mask;
+        size_t chunk = MIN(left, stream->mask + 1 - offset);
+        i2c_write_bytes(i2c, stream->buf + offset, chunk);
+        stream->read_pos += chunk;
+        stream->sent_since_pad += chunk;
+        left -= chunk;
+    }
+    if (count == 0 && must_write) {
+        // Master is stretched until something is sent. Pad, and let it find out from the status.
+        i2c_write_byte(i2c, 0xff);
+        if (stream->master_reads) {
+            stream->underruns = stream->underruns + 1;
+            stream->sent_since_pad = 0;
+        }
+    }
+}
+
+static inline void stream_finish(i2c_regmap_stream_t *stream, i2c_inst_t *i2c) {
+    if (!stream->master_reads) {
+        return;
+    }
+    // The Tx FIFO was empty when the last pad byte was written, so only bytes sent after that can
+    // still be waiting there. Hand them back for the next read.
+    stream->read_pos -= MIN((uint32_t)i2c_slave_get_tx_unsent(i2c), stream->sent_since_pad);
+    stream->sent_since_pad = 0;
+    __dmb(); // finish reading before handing the space back to the producer
+    stream->tail = stream->read_pos;
+}
+
+static void I2C_SLAVE_HOT_FUNC(update_stream_status)(i2c_regmap_t *regmap) {
+    for (uint i = 0; i < regmap->config.num_streams; i++) {
+        const i2c_regmap_stream_t *stream = &regmap->config.streams[i];
+        if (stream->status_reg == I2C_REGMAP_NO_STATUS) {
+            continue;
+        }
+        uint32_t used = stream->head - (stream->master_reads ? stream->read_pos : stream->tail);
+        uint32_t level = stream->master_reads ? used : stream->mask + 1 - used;
+        level = MIN(level, 0xffffu);
+        uint8_t *status = regmap->mem + stream->status_reg;
+        status[0] = (uint8_t)level;
+        status[1] = (uint8_t)(level >> 8);
+        status[2] = (uint8_t)stream->underruns;
+        status[3] = (uint8_t)stream->overruns;
+    }
+}
+
+static inline void receive_address_byte(i2c_regmap_t *regmap, uint8_t value) {
+    regmap->pending_address = (regmap->pending_address << 8) | value;
+    regmap->address_bytes++;
+    if (regmap->address_bytes == regmap->config.address_width) {
+        uint32_t address = regmap->pending_address;
+        if (address >= regmap->config.size && regmap->config.wrap) {
+            address %= regmap->config.size;
+        }
+        regmap->address = address;
+        regmap->latch_valid = false;
+        if (regmap->config.num_streams != 0) {
+            select_stream(regmap);
+        }
+    }
+}
+
+static void I2C_SLAVE_HOT_FUNC(prefill)(i2c_regmap_t *regmap, i2c_inst_t *i2c) {
+    // Stage what a read would return from here, but leave the address alone until master
+    // actually reads it.
+    uint8_t buf[I2C_SLAVE_PREFILL_MAX];
+    uint32_t address = regmap->address;
+    // stop on a register boundary, so the rest of a register isn't read from a later snapshot
+    size_t len = sizeof(buf) - (address & (regmap->config.register_width - 1));
+    update_stream_status(regmap);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = read_register(regmap);
+        advance(regmap);
+    }
+    regmap->address = address;
+    i2c_slave_prefill(i2c, buf, len);
+}
+
+static inline void start_read(i2c_regmap_t *regmap, i2c_inst_t *i2c) {
+    regmap->read_started = true;
+    update_stream_status(regmap);
+    for (uint n = i2c_slave_get_tx_prefilled(i2c); n > 0; n--) {
+        advance(regmap);
+    }
+}
+
+static void I2C_SLAVE_HOT_FUNC(i2c_regmap_handler)(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    i2c_regmap_t *regmap = i2c_regmaps[i2c_hw_index(i2c)];
+    uint8_t buf[16]; // FIFO depth
+
+    if (regmap->config.shadow != NULL && regmap->pinned == NO_BANK && event != I2C_SLAVE_FINISH) {
+        // serve the whole transaction from the same snapshot
+        pin_bank(regmap);
+    }
+
+    switch (event) {
+    case I2C_SLAVE_RECEIVE: { // master has written some data
+        size_t count = i2c_read_bytes(i2c, buf, sizeof(buf));
+        size_t i = 0;
+        for (; i < count && regmap->address_bytes < regmap->config.address_width; i++) {
+            // writes always start with the register address
+            receive_address_byte(regmap, buf[i]);
+        }
+        // a write of just the register address is usually followed by a read
+        regmap->address_only = i == count && regmap->address_bytes == regmap->config.address_width
+            && (regmap->address_only || i != 0);
+        if (regmap->stream != NULL) {
+            stream_receive(regmap->stream, buf + i, count - i);
+            break;
+        }
+        for (; i < count; i++) {
+            write_register(regmap, buf[i]);
+            advance(regmap);
+        }
+        break;
+    }
+    case I2C_SLAVE_REQUEST: // master is requesting data
+    case I2C_SLAVE_REFILL: { // master is still reading, with streaming transmit
+        if (!regmap->read_started) {
+            // with a staged response, the read may go straight to I2C_SLAVE_REFILL
+            start_read(regmap, i2c);
+        }
+        if (regmap->stream != NULL) {
+            // the address stays on the stream register
+            stream_send(regmap->stream, i2c, event == I2C_SLAVE_REQUEST);
+            break;
+        }
+        // Fill the whole Tx FIFO. Whatever master doesn't read is accounted for on finish.
+        size_t count = i2c_get_write_available(i2c);
+        for (size_t i = 0; i < count; i++) {
+            buf[i] = read_register(regmap);
+            advance(regmap);
+        }
+        i2c_write_bytes(i2c, buf, count);
+        break;
+    }
+    case I2C_SLAVE_FINISH: // master has signalled Stop / Restart
+        if (regmap->stream != NULL) {
+            stream_finish(regmap->stream, i2c);
+        } else {
+            if (!regmap->read_started && i2c_slave_get_tx_prefilled(i2c) != 0) {
+                // master read only from the staged response
+                start_read(regmap, i2c);
+            }
+            rewind(regmap, i2c_slave_get_tx_unsent(i2c));
+            // With two banks, the read would take the staged bytes from this snapshot and the
+            // rest from whichever bank is current by then, so don't stage anything.
+            if (regmap->address_only && regmap->config.prefill && regmap->config.shadow == NULL) {
+                prefill(regmap, i2c);
+            }
+        }
+        regmap->address_only = false;
+        regmap->read_started = false;
+        regmap->address_bytes = 0;
+        regmap->pending_address = 0;
+        // a partially written register is discarded
+        regmap->latch_valid = false;
+        finish_writes(regmap);
+        regmap->pinned = NO_BANK;
+        break;
+    default:
+        break;
+    }
+}
+
+i2c_regmap_config_t i2c_regmap_get_default_config(uint8_t *mem, uint32_t size) {
+    i2c_regmap_config_t config = {
+        .mem = mem,
+        .size = size,
+        .address_width = 1,
+        .register_width = 1,
+        .wrap = true,
+        .ranges = NULL,
+        .num_ranges = 0,
+        .shadow = NULL,
+        .dirty = NULL,
+        .streams = NULL,
+        .num_streams = 0,
+        .prefill = false,
+    };
+    return config;
+}
+
+void i2c_regmap_init(i2c_regmap_t *regmap, const i2c_regmap_config_t *config) {
+    assert(config->mem != NULL);
+    assert(0 < config->size && config->size <= 65536);
+    assert(config->address_width == 1 || config->address_width == 2);
+    assert(config->register_width == 1 || config->register_width == 2 || config->register_width == 4 || config->register_width == 8);
+    assert(config->size % config->register_width == 0);
+    assert(((uintptr_t)config->mem & (config->register_width - 1)) == 0);
+    assert(((uintptr_t)config->shadow & (config->register_width - 1)) == 0);
+    assert(config->ranges != NULL || config->num_ranges == 0);
+#ifndef NDEBUG
+    for (uint i = 0; i < config->num_ranges; i++) {
+        // ranges must cover whole registers
+        assert(config->ranges[i].start % config->register_width == 0);
+        assert(config->ranges[i].size % config->register_width == 0);
+    }
+#endif
+    assert(config->streams != NULL || config->num_streams == 0);
+#ifndef NDEBUG
+    for (uint i = 0; i < config->num_streams; i++) {
+        const i2c_regmap_stream_t *stream = &config->streams[i];
+        assert(stream->reg < config->size);
+        assert(stream->status_reg == I2C_REGMAP_NO_STATUS || stream->status_reg + 4 <= config->size);
+    }
+#endif
+    bool has_write_hooks = false;
+    for (uint i = 0; i < config->num_ranges; i++) {
+        has_write_hooks |= config->ranges[i].on_write != NULL;
+    }
+
+    regmap->config = *config;
+    regmap->mem = config->mem;
+    regmap->front = 0;
+    regmap->pinned = NO_BANK;
+    regmap->address = 0;
+    regmap->pending_address = 0;
+    regmap->address_bytes = 0;
+    regmap->latch_valid = false;
+    regmap->latch_address = 0;
+    regmap->has_write_hooks = has_write_hooks;
+    regmap->read_started = false;
+    regmap->address_only = false;
+    regmap->stream = NULL;
+    regmap->write_start = 0;
+    regmap->write_span = 0;
+    regmap->write_bytes = 0;
+    if (config->dirty != NULL) {
+        memset(config->dirty, 0, I2C_REGMAP_DIRTY_WORDS(config->size / config->register_width) * sizeof(uint32_t));
+        // only held for a few cycles at a time, so a shared lock will do
+        regmap->dirty_lock = spin_lock_instance(next_striped_spin_lock_num());
+    }
+}
+
+void i2c_regmap_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_regmap_t *regmap) {
+    i2c_slave_config_t config = i2c_slave_get_default_config();
+    i2c_regmap_slave_init_with_config(i2c, address, regmap, &config);
+}
+
+void i2c_regmap_slave_init_with_config(i2c_inst_t *i2c, uint8_t address, i2c_regmap_t *regmap,
+    const i2c_slave_config_t *config) {
+    assert(i2c == i2c0 || i2c == i2c1);
+    assert(regmap != NULL);
+    assert(!config->pec); // not supported, see header
+
+    i2c_regmaps[i2c_hw_index(i2c)] = regmap;
+    i2c_slave_init_with_config(i2c, address, &i2c_regmap_handler, config);
+}
+
+uint8_t *i2c_regmap_begin_update(i2c_regmap_t *regmap) {
+    assert(regmap->config.shadow != NULL);
+
+    uint front = regmap->front;
+    uint back = front ^ 1;
+    while (regmap->pinned == back) {
+        // a transaction which started before the last update is still reading the back bank
+        tight_loop_contents();
+    }
+    uint8_t *mem = bank_mem(regmap, back);
+    memcpy(mem, bank_mem(regmap, front), regmap->config.size);
+    return mem;
+}
+
+void i2c_regmap_end_update(i2c_regmap_t *regmap) {
+    assert(regmap->config.shadow != NULL);
+
+    __dmb(); // fill the bank before publishing it
+    regmap->front = regmap->front ^ 1;
+    __dmb(); // publish before the next i2c_regmap_begin_update() checks the pinned bank
+}
+
+bool i2c_regmap_take_dirty(i2c_regmap_t *regmap, uint32_t *dirty) {
+    assert(regmap->config.dirty != NULL);
+
+    uint num_words = I2C_REGMAP_DIRTY_WORDS(regmap->config.size / regmap->config.register_width);
+    uint32_t any = 0;
+    uint32_t save = spin_lock_blocking(regmap->dirty_lock);
+    for (uint i = 0; i < num_words; i++) {
+        dirty[i] = regmap->config.dirty[i];
+        regmap->config.dirty[i] = 0;
+        any |= dirty[i];
+    }
+    spin_unlock(regmap->dirty_lock, save);
+    return any != 0;
+}
+
+void i2c_regmap_stream_init(i2c_regmap_stream_t *stream, uint32_t reg, bool master_reads, uint8_t *buf,
+    uint32_t size) {
+    assert(buf != NULL);
+    assert(size > 0 && (size & (size - 1)) == 0); // must be a power of two
+
+    stream->reg = reg;
+    stream->status_reg = I2C_REGMAP_NO_STATUS;
+    stream->master_reads = master_reads;
+    stream->buf = buf;
+    stream->mask = size - 1;
+    stream->head = 0;
+    stream->tail = 0;
+    stream->read_pos = 0;
+    stream->sent_since_pad = 0;
+    stream->underruns = 0;
+    stream->overruns = 0;
+}
+
+size_t i2c_regmap_stream_write(i2c_regmap_stream_t *stream, const uint8_t *data, size_t len) {
+    assert(stream->master_reads);
+
+    uint32_t head = stream->head;
+    uint32_t free = stream->mask + 1 - (head - stream->tail);
+    len = MIN(len, free);
+    __dmb(); // write into the ring after seeing the tail update
+    for (size_t done = 0; done < len;) {
+        uint32_t offset = (head + done) & stream->mask;
+        size_t chunk = MIN(len - done, stream->mask + 1 - offset);
+        memcpy(stream->buf + offset, data + done, chunk);
+        done += chunk;
+    }
+    __dmb(); // fill the ring before publishing
+    stream->head = head + len;
+    return len;
+}
+
+size_t i2c_regmap_stream_read(i2c_regmap_stream_t *stream, uint8_t *data, size_t len) {
+    assert(!stream->master_reads);
+
+    uint32_t tail = stream->tail;
+    len = MIN(len, stream->head - tail);
+    __dmb(); // read the ring after seeing the head update
+    for (size_t done = 0; done < len;) {
+        uint32_t offset = (tail + done) & stream->mask;
+        size_t chunk = MIN(len - done, stream->mask + 1 - offset);
+        memcpy(data + done, stream->buf + offset, chunk);
+        done += chunk;
+    }
+    __dmb(); // finish with the ring before handing the space back
+    stream->tail = tail + len;
+    return len;
+}
@@ -5,25 +5,378 @@
  */
 
 #include <i2c_slave.h>
+#include <i2c_fifo.h>
+#include <i2c_pec.h>
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
 #include <hardware/irq.h>
+#include <hardware/sync.h>
+#include <string.h>
+#if I2C_SLAVE_PROFILE
+#include <hardware/structs/systick.h>
+#endif
+#if I2C_SLAVE_TRACE
+#include <hardware/timer.h>
+#include <stdio.h>
+#endif
+
+// The Rx DMA channel runs with the maximum transfer count, and is re-armed between transfers
+// well before it runs out.
+#define RX_DMA_TRANSFER_COUNT 0xffffffffu
+#define RX_DMA_REARM_THRESHOLD 0x80000000u
+
+// Interrupts which deliver received data, or end a transfer (and with it the received data). They
+// are masked while receive is paused, so the handler sees events in their original order later.
+#define RX_PAUSE_INTR_BITS (I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_START_DET_BITS)
 
 typedef struct i2c_slave_t
 {
     i2c_inst_t *i2c;
-    i2c_slave_handler_t handler;
+    i2c_slave_handler_t handler; // NULL when initialized with callbacks
+    i2c_slave_callbacks_t callbacks;
+    irq_handler_t irq_handler;
+    uint8_t address;
     bool transfer_in_progress;
+    bool transfer_is_read;
+    uint tx_unsent; // bytes written into Tx FIFO but not sent, for the last transfer
+    uint tx_written; // bytes written into Tx FIFO during the current transfer
+    bool rx_dma_enabled;
+    uint rx_dma_channel;
+    uint8_t *rx_ring;
+    uint32_t rx_ring_mask;
+    uint32_t rx_dma_base; // bytes received before the Rx DMA channel was last armed
+    uint32_t rx_dma_tail; // bytes consumed from the ring buffer
+    bool tx_dma_enabled;
+    bool tx_dma_active; // the response buffer is being sent in the current transfer
+    uint tx_dma_channel;
+    const uint8_t *tx_dma_data;
+    size_t tx_dma_len;
+    bool tx_streaming; // refill Tx FIFO on TX_EMPTY during reads
+    bool tx_streaming_active;
+    bool rx_hold_bus;
+    bool rx_paused;
+    bool pec_enabled;
+    uint8_t pec; // running PEC since the last Stop
+    bool pec_valid; // for the transfer that has just finished
+    uint tx_pushed; // bytes written with i2c_slave_write(), PEC only
+    uint8_t prefill[I2C_SLAVE_PREFILL_MAX]; // staged response for the next read
+    uint8_t prefill_len;
+    uint8_t tx_prefilled; // staged bytes sent at the start of the current read
+    uint8_t irq_core;
+    uint8_t irq_priority;
+    i2c_slave_stats_t stats;
+#if I2C_SLAVE_PROFILE
+    uint32_t isr_start;
+    i2c_slave_profile_t profile;
+#endif
+#if I2C_SLAVE_TRACE
+    volatile bool trace_frozen;
+    uint32_t trace_intr_stat; // for the ISR run being traced
+    uint32_t trace_head; // records written since the trace was restarted
+    i2c_slave_trace_record_t trace[I2C_SLAVE_TRACE_LENGTH];
+#endif
 } i2c_slave_t;
 
-static i2c_slave_t i2c_slaves[2];
+static I2C_SLAVE_HOT_DATA("i2c_slave") i2c_slave_t i2c_slaves[2];
+
+#if I2C_SLAVE_PROFILE
+
+#define SYSTICK_MAX 0xffffffu
+
+static inline uint32_t profile_now() {
+    return systick_hw->cvr;
+}
+
+static inline void profile_record(i2c_slave_timing_t *timing, uint32_t start) {
+    // SysTick counts down
+    uint32_t cycles = (start - profile_now()) & SYSTICK_MAX;
+    timing->count++;
+    timing->min = MIN(timing->min, cycles);
+    timing->max = MAX(timing->max, cycles);
+    timing->total += cycles;
+    uint bucket = cycles == 0 ? 0 : 32 - __builtin_clz(cycles);
+    timing->histogram[MIN(bucket, I2C_SLAVE_PROFILE_BUCKETS - 1)]++;
+}
+
+static void profile_reset(i2c_slave_profile_t *profile) {
+    memset(profile, 0, sizeof(*profile));
+    profile->isr.min = UINT32_MAX;
+    profile->handler.min = UINT32_MAX;
+    profile->rd_req_response.min = UINT32_MAX;
+}
+
+#endif
+
+#if I2C_SLAVE_TRACE
+
+static_assert((I2C_SLAVE_TRACE_LENGTH & (I2C_SLAVE_TRACE_LENGTH - 1)) == 0, "I2C_SLAVE_TRACE_LENGTH must be a power of two");
+
+static inline void trace_record(i2c_slave_t *slave, i2c_slave_trace_event_t event, uint level, uint count) {
+    if (slave->trace_frozen) {
+        return;
+    }
+    i2c_slave_trace_record_t *record = &slave->trace[slave->trace_head & (I2C_SLAVE_TRACE_LENGTH - 1)];
+    record->timestamp_us = time_us_32();
+    record->intr_stat = (uint16_t)slave->trace_intr_stat;
+    record->event = (uint8_t)event;
+    record->level = (uint8_t)level;
+    record->count = (uint16_t)count;
+    slave->trace_head++;
+}
+
+// A macro, so FIFO levels aren't even read when tracing is disabled.
+#define TRACE(slave, event, level, count) trace_record(slave, event, level, count)
+
+#else
+
+#define TRACE(slave, event, level, count) ((void)0)
+
+#endif
+
+static inline i2c_slave_callback_t get_callback(const i2c_slave_t *slave, i2c_slave_event_t event) {
+    switch (event) {
+    case I2C_SLAVE_RECEIVE:
+        return slave->callbacks.receive;
+    case I2C_SLAVE_REQUEST:
+        return slave->callbacks.request;
+    case I2C_SLAVE_FINISH:
+        return slave->callbacks.finish;
+    case I2C_SLAVE_REFILL:
+        return slave->callbacks.refill;
+    default:
+        return NULL;
+    }
+}
+
+static inline void call_callback(i2c_slave_t *slave, i2c_slave_callback_t callback) {
+#if I2C_SLAVE_PROFILE
+    uint32_t start = profile_now();
+    callback(slave->i2c, slave->callbacks.user);
+    profile_record(&slave->profile.handler, start);
+#else
+    callback(slave->i2c, slave->callbacks.user);
+#endif
+}
+
+static inline void call_handler(i2c_slave_t *slave, i2c_slave_event_t event) {
+    if (slave->handler == NULL) {
+        // The event is known at each call site, so this folds into a single load.
+        i2c_slave_callback_t callback = get_callback(slave, event);
+        if (callback != NULL) {
+            call_callback(slave, callback);
+        }
+        return;
+    }
+#if I2C_SLAVE_PROFILE
+    uint32_t start = profile_now();
+    slave->handler(slave->i2c, event);
+    profile_record(&slave->profile.handler, start);
+#else
+    slave->handler(slave->i2c, event);
+#endif
+}
+
+static inline void drop_prefill(i2c_slave_t *slave) {
+    if (slave->prefill_len != 0) {
+        slave->prefill_len = 0;
+        slave->stats.tx_prefill_misses++;
+    }
+}
+
+static inline uint push_prefill(i2c_slave_t *slave) {
+    i2c_hw_t *hw = i2c_get_hw(slave->i2c);
+    uint len = slave->prefill_len;
+    for (uint i = 0; i < len; i++) {
+        hw->data_cmd = slave->prefill[i];
+    }
+    slave->prefill_len = 0;
+    return len;
+}
+
+static inline void begin_transfer(i2c_slave_t *slave, bool is_read) {
+    if (!slave->transfer_in_progress) {
+        slave->transfer_in_progress = true;
+        if (!is_read) {
+            // a new write, so the read which was predicted isn't coming
+            drop_prefill(slave);
+        }
+        if (slave->pec_enabled) {
+            // PEC goes on across Restart, so the command part of a write / read is covered too
+            slave->pec = i2c_pec_update(slave->pec, i2c_pec_address_byte(slave->address, is_read));
+        }
+        if (slave->callbacks.start != NULL) {
+            call_callback(slave, slave->callbacks.start);
+        }
+    }
+}
+
+static inline uint32_t rx_dma_head(const i2c_slave_t *slave) {
+    return slave->rx_dma_base + (RX_DMA_TRANSFER_COUNT - dma_hw->ch[slave->rx_dma_channel].transfer_count);
+}
+
+static inline uint32_t rx_dma_available(i2c_slave_t *slave) {
+    uint32_t available = rx_dma_head(slave) - slave->rx_dma_tail;
+    if (available > slave->rx_ring_mask + 1) {
+        // the handler fell behind and older data has been overwritten
+        available = slave->rx_ring_mask + 1;
+        slave->rx_dma_tail = rx_dma_head(slave) - available;
+        slave->stats.rx_ring_overflows++;
+    }
+    return available;
+}
+
+static void I2C_SLAVE_HOT_FUNC(rx_dma_arm)(i2c_slave_t *slave) {
+    uint32_t head = slave->rx_dma_base;
+    dma_channel_set_write_addr(slave->rx_dma_channel, slave->rx_ring + (head & slave->rx_ring_mask), false);
+    dma_channel_set_trans_count(slave->rx_dma_channel, RX_DMA_TRANSFER_COUNT, true);
+}
+
+static void I2C_SLAVE_HOT_FUNC(rx_dma_rearm_if_needed)(i2c_slave_t *slave) {
+    if (dma_hw->ch[slave->rx_dma_channel].transfer_count < RX_DMA_REARM_THRESHOLD) {
+        // Any bytes arriving in the meantime wait in the Rx FIFO until the channel is restarted.
+        dma_channel_abort(slave->rx_dma_channel);
+        slave->rx_dma_base = rx_dma_head(slave);
+        rx_dma_arm(slave);
+    }
+}
+
+static inline bool tx_dma_request(i2c_slave_t *slave) {
+    if (slave->tx_dma_active) {
+        // once the response buffer is exhausted, further requests go to the handler
+        return dma_channel_is_busy(slave->tx_dma_channel);
+    }
+    if (slave->tx_dma_len == 0) {
+        return false;
+    }
+    dma_channel_transfer_from_buffer_now(slave->tx_dma_channel, slave->tx_dma_data, slave->tx_dma_len);
+    slave->tx_dma_active = true;
+    if (slave->pec_enabled) {
+        // The bus is no longer stretched, so this overlaps with sending. If master stops
+        // early, it isn't expecting a PEC byte anyway.
+        slave->pec = i2c_pec_update_buf(slave->pec, slave->tx_dma_data, slave->tx_dma_len);
+    }
+    return true;
+}
+
+static inline void start_tx_streaming(i2c_slave_t *slave) {
+    i2c_hw_t *hw = i2c_get_hw(slave->i2c);
+    hw->clr_rx_done;
+    hw_set_bits(&hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS | I2C_IC_INTR_MASK_M_RX_DONE_BITS);
+    slave->tx_streaming_active = true;
+}
+
+static inline void stop_tx_streaming(i2c_slave_t *slave) {
+    i2c_hw_t *hw = i2c_get_hw(slave->i2c);
+    hw_clear_bits(&hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS | I2C_IC_INTR_MASK_M_RX_DONE_BITS);
+    slave->tx_streaming_active = false;
+}
+
+static inline uint rx_level(i2c_slave_t *slave) {
+    return slave->rx_dma_enabled ? rx_dma_available(slave) : i2c_get_hw(slave->i2c)->rxflr;
+}
+
+static inline void discard_received(i2c_slave_t *slave) {
+    // through the slave accessors, so the discarded data still counts towards PEC
+    uint8_t sink[16];
+    if (slave->rx_dma_enabled) {
+        while (i2c_slave_rx_dma_read(slave->i2c, sink, sizeof(sink)) != 0) {
+        }
+    } else {
+        while (i2c_slave_read(slave->i2c, sink, sizeof(sink)) != 0) {
+        }
+    }
+}
 
-static inline void finish_transfer(i2c_slave_t *slave) {
+static inline void handle_receive(i2c_slave_t *slave) {
+    // Bytes arriving while the handler runs may be missed here, they show up in the next call
+    // at best. With DMA receive, the whole transfer has landed by the time the handler is called.
+    begin_transfer(slave, false);
+    uint level = rx_level(slave);
+    if (slave->handler == NULL && slave->callbacks.receive == NULL) {
+        // nobody to take the data, and left in the Rx FIFO it would keep RX_FULL raised
+        discard_received(slave);
+    } else {
+        call_handler(slave, I2C_SLAVE_RECEIVE);
+    }
+    uint left = rx_level(slave);
+    if (left < level) {
+        slave->stats.rx_bytes += level - left;
+    }
+    TRACE(slave, I2C_SLAVE_TRACE_RECEIVE, left, left < level ? level - left : 0);
+}
+
+static inline uint handle_request(i2c_slave_t *slave, i2c_slave_event_t event) {
+    i2c_hw_t *hw = i2c_get_hw(slave->i2c);
+    uint level = hw->txflr;
+    call_handler(slave, event);
+    uint written = hw->txflr > level ? hw->txflr - level : 0;
+    slave->tx_written += written;
+    TRACE(slave, event == I2C_SLAVE_REQUEST ? I2C_SLAVE_TRACE_REQUEST : I2C_SLAVE_TRACE_REFILL, hw->txflr, written);
+    return written;
+}
+
+static inline void send_pec(i2c_slave_t *slave) {
+    i2c_get_hw(slave->i2c)->data_cmd = slave->pec;
+    slave->pec = i2c_pec_update(slave->pec, slave->pec);
+    slave->tx_written++;
+}
+
+static inline void count_tx_aborts(i2c_slave_t *slave, uint32_t abort_source) {
+    slave->stats.tx_aborts++;
+    abort_source &= (1u << I2C_SLAVE_TX_ABORT_SOURCES) - 1;
+    while (abort_source != 0) {
+        uint bit = (uint)__builtin_ctz(abort_source);
+        slave->stats.tx_abort_sources[bit]++;
+        abort_source &= abort_source - 1;
+    }
+}
+
+static inline void finish_transfer(i2c_slave_t *slave, uint tx_flushed) {
+    i2c_hw_t *hw = i2c_get_hw(slave->i2c);
+    if (!slave->rx_dma_enabled) {
+        // With an Rx threshold above 1, the tail of the transfer may still be waiting in the Rx FIFO.
+        while (hw->rxflr != 0) {
+            handle_receive(slave);
+        }
+    } else {
+        while (hw->rxflr != 0 && dma_channel_is_busy(slave->rx_dma_channel)) {
+            tight_loop_contents(); // let DMA drain the last bytes of the transfer
+        }
+        if (rx_dma_available(slave) != 0) {
+            handle_receive(slave);
+        }
+    }
+    if (slave->tx_streaming_active) {
+        stop_tx_streaming(slave);
+    }
+    if (slave->tx_dma_active) {
+        // Stop feeding the Tx FIFO. Any bytes the master didn't read are flushed by hardware
+        // on the next read request.
+        dma_channel_abort(slave->tx_dma_channel);
+        slave->tx_written += slave->tx_dma_len - dma_hw->ch[slave->tx_dma_channel].transfer_count;
+        slave->tx_dma_active = false;
+    }
     if (slave->transfer_in_progress) {
-        slave->handler(slave->i2c, I2C_SLAVE_FINISH);
+        // Unsent bytes are either still in the Tx FIFO, or have just been flushed by TX_ABRT.
+        slave->tx_unsent = slave->transfer_is_read ? hw->txflr + tx_flushed : 0;
+        if (slave->tx_written > slave->tx_unsent) {
+            slave->stats.tx_bytes += slave->tx_written - slave->tx_unsent;
+        }
+        slave->stats.transfers++;
+        slave->pec_valid = slave->pec_enabled && !slave->transfer_is_read && slave->pec == 0;
+        TRACE(slave, I2C_SLAVE_TRACE_FINISH, slave->transfer_is_read, slave->tx_unsent);
+        call_handler(slave, I2C_SLAVE_FINISH);
         slave->transfer_in_progress = false;
+        slave->transfer_is_read = false;
+        slave->tx_written = 0;
+        slave->tx_prefilled = 0;
+    }
+    if (slave->rx_dma_enabled) {
+        rx_dma_rearm_if_needed(slave);
     }
 }
 
-static void __not_in_flash_func(i2c_slave_irq_handler)(i2c_slave_t *slave) {
+static void I2C_SLAVE_HOT_FUNC(i2c_slave_irq_handler)(i2c_slave_t *slave) {
     i2c_inst_t *i2c = slave->i2c;
     i2c_hw_t *hw = i2c_get_hw(i2c);
 
@@ -31,59 +384,299 @@ static void __not_in_flash_func(i2c_slave_irq_handler)(i2c_slave_t *slave) {
     if (intr_stat == 0) {
         return;
     }
+#if I2C_SLAVE_TRACE
+    slave->trace_intr_stat = intr_stat;
+#endif
+    TRACE(slave, I2C_SLAVE_TRACE_IRQ, hw->rxflr, hw->txflr);
+    uint prefilled = 0;
+    if ((intr_stat & (I2C_IC_INTR_STAT_R_RD_REQ_BITS | I2C_IC_INTR_STAT_R_TX_ABRT_BITS | I2C_IC_INTR_STAT_R_STOP_DET_BITS)) == I2C_IC_INTR_STAT_R_RD_REQ_BITS
+        && slave->prefill_len != 0 && !slave->transfer_is_read && rx_level(slave) == 0) {
+        // A read starting right after the write which staged its response. Release master first,
+        // and finish the write below. With TX_ABRT the Tx FIFO must be cleared before it can be
+        // written, with Stop the prediction no longer holds, and with data still waiting in the
+        // Rx FIFO it may belong to a newer write.
+        prefilled = push_prefill(slave);
+#if I2C_SLAVE_PROFILE
+        profile_record(&slave->profile.rd_req_response, slave->isr_start);
+#endif
+    }
     if (intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // abort source is cleared together with the interrupt
+        uint32_t abort_source = hw->tx_abrt_source;
+        uint tx_flushed = (abort_source & I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_BITS) >> I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_LSB;
         hw->clr_tx_abrt;
-        finish_transfer(slave);
+        TRACE(slave, I2C_SLAVE_TRACE_ABORT, tx_flushed, abort_source);
+        count_tx_aborts(slave, abort_source);
+        finish_transfer(slave, tx_flushed);
+    }
+    if (intr_stat & I2C_IC_INTR_STAT_R_RX_OVER_BITS) {
+        // master wrote into a full Rx FIFO, and the byte was dropped
+        hw->clr_rx_over;
+        slave->stats.rx_overflows++;
     }
     if (intr_stat & I2C_IC_INTR_STAT_R_START_DET_BITS) {
         hw->clr_start_det;
-        finish_transfer(slave);
+        finish_transfer(slave, 0);
     }
     if (intr_stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
         hw->clr_stop_det;
-        finish_transfer(slave);
+        finish_transfer(slave, 0);
+        slave->pec = 0; // next transaction
+        drop_prefill(slave);
     }
-    if (intr_stat & I2C_IC_INTR_STAT_R_RX_FULL_BITS) {
-        slave->transfer_in_progress = true;
-        slave->handler(i2c, I2C_SLAVE_RECEIVE);
+    if (intr_stat & I2C_IC_INTR_STAT_R_RX_DONE_BITS) {
+        // master has NACKed the last byte of a read
+        hw->clr_rx_done;
+        if (slave->tx_streaming_active) {
+            stop_tx_streaming(slave);
+        }
+    }
+    // the Rx FIFO may have been drained already, when finishing the previous transfer
+    if ((intr_stat & I2C_IC_INTR_STAT_R_RX_FULL_BITS) && hw->rxflr != 0) {
+        handle_receive(slave);
     }
     if (intr_stat & I2C_IC_INTR_STAT_R_RD_REQ_BITS) {
+        // master is waiting on an empty Tx FIFO, with the bus stretched
         hw->clr_rd_req;
-        slave->transfer_in_progress = true;
-        slave->handler(i2c, I2C_SLAVE_REQUEST);
+        slave->stats.read_requests++;
+        bool starting = !slave->transfer_in_progress;
+        begin_transfer(slave, true);
+        slave->transfer_is_read = true;
+        uint staged = prefilled;
+        if (staged == 0 && starting) {
+            // staged while finishing the previous transfer above
+            staged = push_prefill(slave);
+        }
+        if (staged != 0) {
+            // the response was staged ahead, see i2c_slave_prefill()
+            slave->tx_prefilled = (uint8_t)staged;
+            slave->tx_written += staged;
+            slave->stats.tx_prefills++;
+            if (slave->tx_streaming && !slave->tx_streaming_active) {
+                start_tx_streaming(slave);
+            }
+        } else if (!slave->tx_dma_enabled || !tx_dma_request(slave)) {
+            uint pushed = slave->tx_pushed;
+            handle_request(slave, I2C_SLAVE_REQUEST);
+            if (slave->pec_enabled && slave->tx_pushed == pushed) {
+                // the handler has nothing more to send, so the response is complete
+                send_pec(slave);
+            }
+            if (slave->tx_streaming && !slave->tx_streaming_active && hw->txflr != 0) {
+                start_tx_streaming(slave);
+            }
+        }
+#if I2C_SLAVE_PROFILE
+        // the bus is stretched from RD_REQ until the first byte is in the Tx FIFO, this measures
+        // the part spent in the ISR
+        if (prefilled == 0 && (hw->txflr != 0 || slave->tx_dma_active)) {
+            profile_record(&slave->profile.rd_req_response, slave->isr_start);
+        }
+#endif
     }
+    // TX_EMPTY may have been masked while handling the events above
+    if ((intr_stat & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS) && slave->tx_streaming_active) {
+        if (handle_request(slave, I2C_SLAVE_REFILL) == 0) {
+            // Nothing more to send for now. If master keeps reading, the Tx FIFO runs empty and
+            // we're back to I2C_SLAVE_REQUEST.
+            stop_tx_streaming(slave);
+        }
+    }
+}
+
+static inline void service_irq(i2c_slave_t *slave) {
+#if I2C_SLAVE_PROFILE
+    slave->isr_start = profile_now();
+    i2c_slave_irq_handler(slave);
+    profile_record(&slave->profile.isr, slave->isr_start);
+#else
+    i2c_slave_irq_handler(slave);
+#endif
+}
+
+static void I2C_SLAVE_HOT_FUNC(i2c0_slave_irq_handler)() {
+    service_irq(&i2c_slaves[0]);
+}
+
+static void I2C_SLAVE_HOT_FUNC(i2c1_slave_irq_handler)() {
+    service_irq(&i2c_slaves[1]);
 }
 
-static void __not_in_flash_func(i2c0_slave_irq_handler)() {
-    i2c_slave_irq_handler(&i2c_slaves[0]);
+static void enable_irq(i2c_slave_t *slave) {
+    // NVIC enable and priority are per core
+    uint num = I2C0_IRQ + i2c_hw_index(slave->i2c);
+    irq_set_priority(num, slave->irq_priority);
+#if I2C_SLAVE_PROFILE
+    if (!(systick_hw->csr & M0PLUS_SYST_CSR_ENABLE_BITS)) {
+        // SysTick is per core too, run it free from the processor clock
+        systick_hw->rvr = SYSTICK_MAX;
+        systick_hw->cvr = 0;
+        systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    }
+#endif
+    irq_set_enabled(num, true);
 }
 
-static void __not_in_flash_func(i2c1_slave_irq_handler)() {
-    i2c_slave_irq_handler(&i2c_slaves[1]);
+static inline uint ns_to_cycles(uint ns) {
+    // round up, so timings are never shorter than requested
+    return (uint)(((uint64_t)ns * clock_get_hz(clk_sys) + 999999999u) / 1000000000u);
+}
+
+static void set_timing(i2c_hw_t *hw, const i2c_slave_config_t *config) {
+    if (config->sda_setup_ns != 0) {
+        // one extra cycle for synchronization, and at least 2 as required by DW_apb_i2c
+        hw->sda_setup = MIN(MAX(ns_to_cycles(config->sda_setup_ns) + 1, 2), I2C_IC_SDA_SETUP_BITS);
+    }
+    if (config->sda_hold_ns != 0) {
+        uint hold = MIN(ns_to_cycles(config->sda_hold_ns), I2C_IC_SDA_HOLD_IC_SDA_TX_HOLD_BITS);
+        hw->sda_hold = (hw->sda_hold & ~I2C_IC_SDA_HOLD_IC_SDA_TX_HOLD_BITS) | (hold << I2C_IC_SDA_HOLD_IC_SDA_TX_HOLD_LSB);
+    }
+    if (config->spike_ns != 0) {
+        hw->fs_spklen = MIN(MAX(ns_to_cycles(config->spike_ns), 1), I2C_IC_FS_SPKLEN_BITS);
+    }
+}
+
+i2c_slave_config_t i2c_slave_get_default_config(void) {
+    i2c_slave_config_t config = {
+        .rx_threshold = 1,
+        .tx_threshold = 0,
+        .tx_streaming = false,
+        .rx_hold_bus = false,
+        .irq_core = (uint8_t)get_core_num(),
+        .irq_priority = PICO_DEFAULT_IRQ_PRIORITY,
+        .sda_setup_ns = 0,
+        .sda_hold_ns = 0,
+        .spike_ns = 0,
+        .pec = false,
+    };
+    return config;
+}
+
+i2c_slave_config_t i2c_slave_get_fast_mode_plus_config(void) {
+    i2c_slave_config_t config = i2c_slave_get_default_config();
+    // At 1 Mb/s a byte takes about 9 us. Batch the Rx FIFO to cut the interrupt rate, while leaving
+    // 8 bytes (~70 us) of headroom. Keep the Tx FIFO topped up, so reads aren't stretched.
+    config.rx_threshold = 8;
+    config.tx_threshold = 8;
+    config.tx_streaming = true;
+    // I2C spec: tSU;DAT >= 50 ns, tVD;DAT <= 450 ns, and spikes up to 50 ns must be suppressed.
+    // The hold time matches what i2c_set_baudrate() picks for 1 MHz masters.
+    config.sda_setup_ns = 50;
+    config.sda_hold_ns = 120;
+    config.spike_ns = 50;
+    return config;
 }
 
 void i2c_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handler) {
+    i2c_slave_config_t config = i2c_slave_get_default_config();
+    i2c_slave_init_with_config(i2c, address, handler, &config);
+}
+
+static void init_slave(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handler,
+    const i2c_slave_callbacks_t *callbacks, irq_handler_t irq_handler, const i2c_slave_config_t *config) {
     assert(i2c == i2c0 || i2c == i2c1);
-    assert(handler != NULL);
+    assert(1 <= config->rx_threshold && config->rx_threshold <= 16);
+    assert(config->tx_threshold <= 15);
+    assert(config->irq_core <= 1);
 
     uint i2c_index = i2c_hw_index(i2c);
     i2c_slave_t *slave = &i2c_slaves[i2c_index];
     slave->i2c = i2c;
     slave->handler = handler;
+    slave->callbacks = *callbacks;
+    slave->irq_handler = irq_handler != NULL ? irq_handler : (i2c_index == 0 ? i2c0_slave_irq_handler : i2c1_slave_irq_handler);
+    slave->address = address;
+    slave->tx_streaming = config->tx_streaming;
+    slave->tx_streaming_active = false;
+    slave->rx_hold_bus = config->rx_hold_bus;
+    slave->rx_paused = false;
+    slave->pec_enabled = config->pec;
+    slave->pec = 0;
+    slave->pec_valid = false;
+    slave->tx_pushed = 0;
+    slave->prefill_len = 0;
+    slave->tx_prefilled = 0;
+    slave->irq_core = config->irq_core;
+    slave->irq_priority = config->irq_priority;
+    slave->tx_written = 0;
+    memset(&slave->stats, 0, sizeof(slave->stats));
+#if I2C_SLAVE_PROFILE
+    profile_reset(&slave->profile);
+#endif
+#if I2C_SLAVE_TRACE
+    slave->trace_frozen = false;
+    slave->trace_intr_stat = 0;
+    slave->trace_head = 0;
+#endif
 
     // Note: The I2C slave does clock stretching implicitly after a RD_REQ, while the Tx FIFO is empty.
-    // There is also an option to enable clock stretching while the Rx FIFO is full, but we leave it
-    // disabled since the Rx FIFO should never fill up (unless slave->handler() is way too slow).
+    // There is also an option to enable clock stretching while the Rx FIFO is full. It's disabled by
+    // default since the Rx FIFO should never fill up, unless slave->handler() is way too slow or
+    // receive is paused.
     i2c_set_slave_mode(i2c, true, address);
 
     i2c_hw_t *hw = i2c_get_hw(i2c);
+    if (slave->rx_hold_bus || config->sda_setup_ns != 0 || config->sda_hold_ns != 0 || config->spike_ns != 0) {
+        // IC_CON and the timing registers can only be written while the I2C block is disabled
+        hw->enable = 0;
+        if (slave->rx_hold_bus) {
+            hw_set_bits(&hw->con, I2C_IC_CON_RX_FIFO_FULL_HLD_CTRL_BITS);
+        }
+        set_timing(hw, config);
+        hw->enable = 1;
+    }
+    // RX_FULL is raised once the Rx FIFO level goes above rx_tl, TX_EMPTY once the Tx FIFO level
+    // drops to tx_tl or below
+    hw->rx_tl = config->rx_threshold - 1;
+    hw->tx_tl = config->tx_threshold;
+
     // unmask necessary interrupts
-    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS | I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_START_DET_BITS;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS | I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_START_DET_BITS | I2C_IC_INTR_MASK_M_RX_OVER_BITS;
 
-    // enable interrupt for current core
+    // The vector table is shared by both cores, so the handler can be installed from here. The
+    // interrupt itself must be enabled on the target core.
     uint num = I2C0_IRQ + i2c_index;
-    irq_set_exclusive_handler(num, i2c_index == 0 ? i2c0_slave_irq_handler : i2c1_slave_irq_handler);
-    irq_set_enabled(num, true);
+    irq_set_exclusive_handler(num, slave->irq_handler);
+    if (slave->irq_core == get_core_num()) {
+        enable_irq(slave);
+    } else {
+        __dmb(); // publish slave state before the other core enables the interrupt
+    }
+}
+
+void i2c_slave_init_with_config(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handler,
+    const i2c_slave_config_t *config) {
+    assert(handler != NULL);
+
+    static const i2c_slave_callbacks_t no_callbacks = {0};
+    init_slave(i2c, address, handler, &no_callbacks, NULL, config);
+}
+
+void i2c_slave_init_with_callbacks(i2c_inst_t *i2c, uint8_t address, const i2c_slave_callbacks_t *callbacks,
+    const i2c_slave_config_t *config) {
+    assert(callbacks != NULL);
+
+    init_slave(i2c, address, NULL, callbacks, NULL, config);
+}
+
+void i2c_slave_init_with_irq_handler(i2c_inst_t *i2c, uint8_t address, irq_handler_t irq_handler,
+    const i2c_slave_config_t *config) {
+    assert(irq_handler != NULL);
+    assert(!config->pec); // not supported by custom ISRs
+
+    static const i2c_slave_callbacks_t no_callbacks = {0};
+    init_slave(i2c, address, NULL, &no_callbacks, irq_handler, config);
+}
+
+void i2c_slave_enable_irq(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->i2c == i2c); // should be called after i2c_slave_init()
+    assert(slave->irq_core == get_core_num()); // should be called on the core set in i2c_slave_config_t
+
+    __dmb();
+    enable_irq(slave);
 }
 
 void i2c_slave_deinit(i2c_inst_t *i2c) {
@@ -92,17 +685,356 @@ void i2c_slave_deinit(i2c_inst_t *i2c) {
     uint i2c_index = i2c_hw_index(i2c);
     i2c_slave_t *slave = &i2c_slaves[i2c_index];
     assert(slave->i2c == i2c); // should be called after i2c_slave_init()
+    assert(slave->irq_core == get_core_num()); // should be called on the core running the ISR
+
+    uint num = I2C0_IRQ + i2c_index;
+    irq_set_enabled(num, false);
+    irq_remove_handler(num, slave->irq_handler);
+
+    if (slave->rx_dma_enabled) {
+        i2c_slave_disable_rx_dma(i2c);
+    }
+    if (slave->tx_dma_enabled) {
+        i2c_slave_disable_tx_dma(i2c);
+    }
 
     slave->i2c = NULL;
     slave->handler = NULL;
+    slave->irq_handler = NULL;
+    memset(&slave->callbacks, 0, sizeof(slave->callbacks));
     slave->transfer_in_progress = false;
-
-    uint num = I2C0_IRQ + i2c_index;
-    irq_set_enabled(num, false);
-    irq_remove_handler(num, i2c_index == 0 ? i2c0_slave_irq_handler : i2c1_slave_irq_handler);
+    slave->transfer_is_read = false;
+    slave->tx_unsent = 0;
+    slave->tx_written = 0;
+    slave->tx_streaming = false;
+    slave->tx_streaming_active = false;
+    slave->rx_paused = false;
+    slave->pec_enabled = false;
+    slave->pec = 0;
+    slave->pec_valid = false;
+    slave->prefill_len = 0;
+    slave->tx_prefilled = 0;
 
     i2c_hw_t *hw = i2c_get_hw(i2c);
     hw->intr_mask = I2C_IC_INTR_MASK_RESET;
+    hw->rx_tl = 0;
+    hw->tx_tl = 0;
+    if (slave->rx_hold_bus) {
+        hw->enable = 0;
+        hw_clear_bits(&hw->con, I2C_IC_CON_RX_FIFO_FULL_HLD_CTRL_BITS);
+        slave->rx_hold_bus = false;
+    }
 
     i2c_set_slave_mode(i2c, false, 0);
 }
+
+#if I2C_SLAVE_PROFILE
+
+void i2c_slave_get_profile(i2c_inst_t *i2c, i2c_slave_profile_t *profile) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    *profile = i2c_slaves[i2c_hw_index(i2c)].profile;
+}
+
+void i2c_slave_reset_profile(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    profile_reset(&i2c_slaves[i2c_hw_index(i2c)].profile);
+}
+
+#endif
+
+#if I2C_SLAVE_TRACE
+
+void I2C_SLAVE_HOT_FUNC(i2c_slave_trace_freeze)(i2c_inst_t *i2c) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    slave->trace_frozen = true;
+    __dmb(); // a record may still be completing on the other core, see i2c_slave_trace_read()
+}
+
+void i2c_slave_trace_restart(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    slave->trace_frozen = true;
+    __dmb();
+    slave->trace_head = 0;
+    __dmb();
+    slave->trace_frozen = false;
+}
+
+size_t i2c_slave_trace_read(i2c_inst_t *i2c, i2c_slave_trace_record_t *records, size_t max, uint32_t *lost) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    const i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    uint32_t head = slave->trace_head;
+    uint32_t available = MIN(head, I2C_SLAVE_TRACE_LENGTH);
+    if (lost != NULL) {
+        *lost = head - available;
+    }
+    size_t count = MIN(max, available);
+    // oldest first
+    for (size_t i = 0; i < count; i++) {
+        records[i] = slave->trace[(head - available + i) & (I2C_SLAVE_TRACE_LENGTH - 1)];
+    }
+    return count;
+}
+
+void i2c_slave_trace_dump(i2c_inst_t *i2c) {
+    static const char *const event_names[] = {
+        [I2C_SLAVE_TRACE_IRQ] = "irq",
+        [I2C_SLAVE_TRACE_RECEIVE] = "receive",
+        [I2C_SLAVE_TRACE_REQUEST] = "request",
+        [I2C_SLAVE_TRACE_REFILL] = "refill",
+        [I2C_SLAVE_TRACE_FINISH] = "finish",
+        [I2C_SLAVE_TRACE_ABORT] = "abort",
+    };
+
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    i2c_slave_trace_freeze(i2c);
+    const i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    uint32_t head = slave->trace_head;
+    uint32_t count = MIN(head, I2C_SLAVE_TRACE_LENGTH);
+    printf("i2c%u trace: %lu records, %lu lost\n", i2c_hw_index(i2c), (unsigned long)count, (unsigned long)(head - count));
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        // one at a time, rather than copying the whole ring onto the stack
+        const i2c_slave_trace_record_t record = slave->trace[(head - count + i) & (I2C_SLAVE_TRACE_LENGTH - 1)];
+        const char *name = record.event < count_of(event_names) ? event_names[record.event] : "?";
+        printf("%10lu us (+%5lu)  %-7s  intr_stat 0x%04x  level %3u  count %5u\n", (unsigned long)record.timestamp_us,
+            (unsigned long)(i == 0 ? 0 : record.timestamp_us - prev), name, record.intr_stat, record.level,
+            record.count);
+        prev = record.timestamp_us;
+    }
+}
+
+#endif // I2C_SLAVE_TRACE
+
+void i2c_slave_pause_rx(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->i2c == i2c); // should be called after i2c_slave_init()
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    slave->rx_paused = true;
+    // atomic, since the ISR may be updating the mask on the other core
+    hw_clear_bits(&hw->intr_mask, RX_PAUSE_INTR_BITS);
+    if (slave->rx_dma_enabled) {
+        // leave incoming data in the Rx FIFO, so the bus is held once it fills up
+        hw_clear_bits(&hw->dma_cr, I2C_IC_DMA_CR_RDMAE_BITS);
+    }
+}
+
+void i2c_slave_resume_rx(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->i2c == i2c); // should be called after i2c_slave_init()
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    slave->rx_paused = false;
+    if (slave->rx_dma_enabled) {
+        hw_set_bits(&hw->dma_cr, I2C_IC_DMA_CR_RDMAE_BITS);
+        hw_set_bits(&hw->intr_mask, RX_PAUSE_INTR_BITS & ~I2C_IC_INTR_MASK_M_RX_FULL_BITS);
+    } else {
+        // events latched in the meantime are served right away
+        hw_set_bits(&hw->intr_mask, RX_PAUSE_INTR_BITS);
+    }
+}
+
+bool i2c_slave_is_rx_paused(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    return i2c_slaves[i2c_hw_index(i2c)].rx_paused;
+}
+
+void i2c_slave_get_stats(i2c_inst_t *i2c, i2c_slave_stats_t *stats) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    *stats = i2c_slaves[i2c_hw_index(i2c)].stats;
+}
+
+size_t I2C_SLAVE_HOT_FUNC(i2c_slave_read)(i2c_inst_t *i2c, uint8_t *dst, size_t max) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    size_t count = i2c_read_bytes(i2c, dst, max);
+    if (slave->pec_enabled) {
+        slave->pec = i2c_pec_update_buf(slave->pec, dst, count);
+    }
+    return count;
+}
+
+size_t I2C_SLAVE_HOT_FUNC(i2c_slave_write)(i2c_inst_t *i2c, const uint8_t *src, size_t max) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    size_t count = i2c_write_bytes(i2c, src, max);
+    if (slave->pec_enabled) {
+        slave->pec = i2c_pec_update_buf(slave->pec, src, count);
+        slave->tx_pushed += count;
+    }
+    return count;
+}
+
+bool I2C_SLAVE_HOT_FUNC(i2c_slave_is_pec_valid)(i2c_inst_t *i2c) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->pec_enabled);
+
+    return slave->pec_valid;
+}
+
+void I2C_SLAVE_HOT_FUNC(i2c_slave_prefill)(i2c_inst_t *i2c, const uint8_t *data, size_t len) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(data != NULL || len == 0);
+    assert(len <= I2C_SLAVE_PREFILL_MAX);
+    assert(!slave->pec_enabled && !slave->tx_dma_enabled);
+    assert(slave->irq_handler == i2c0_slave_irq_handler || slave->irq_handler == i2c1_slave_irq_handler);
+
+    if (len == 0) {
+        drop_prefill(slave);
+        return;
+    }
+    // replaces any response staged earlier, which then doesn't count as a miss
+    for (size_t i = 0; i < len; i++) {
+        slave->prefill[i] = data[i];
+    }
+    slave->prefill_len = (uint8_t)len;
+}
+
+uint I2C_SLAVE_HOT_FUNC(i2c_slave_get_tx_prefilled)(i2c_inst_t *i2c) {
+    return i2c_slaves[i2c_hw_index(i2c)].tx_prefilled;
+}
+
+uint I2C_SLAVE_HOT_FUNC(i2c_slave_get_tx_unsent)(i2c_inst_t *i2c) {
+    return i2c_slaves[i2c_hw_index(i2c)].tx_unsent;
+}
+
+void i2c_slave_enable_rx_dma(i2c_inst_t *i2c, uint8_t *ring, uint ring_size_bits) {
+    assert(i2c == i2c0 || i2c == i2c1);
+    assert(ring_size_bits > 0 && ring_size_bits <= 15);
+    assert(((uintptr_t)ring & ((1u << ring_size_bits) - 1)) == 0); // ring must be aligned to its size
+
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->i2c == i2c); // should be called after i2c_slave_init()
+    assert(!slave->rx_dma_enabled);
+    assert(!slave->rx_paused);
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    // stop serving RX_FULL, bytes are collected by DMA from now on
+    hw_clear_bits(&hw->intr_mask, I2C_IC_INTR_MASK_M_RX_FULL_BITS);
+
+    slave->rx_dma_channel = (uint)dma_claim_unused_channel(true);
+    slave->rx_ring = ring;
+    slave->rx_ring_mask = (1u << ring_size_bits) - 1;
+    slave->rx_dma_base = 0;
+    slave->rx_dma_tail = 0;
+
+    dma_channel_config c = dma_channel_get_default_config(slave->rx_dma_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, ring_size_bits);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c, false));
+    dma_channel_configure(slave->rx_dma_channel, &c, ring, &hw->data_cmd, RX_DMA_TRANSFER_COUNT, true);
+
+    // request a DMA transfer as soon as there is a byte in the Rx FIFO
+    hw->dma_rdlr = 0;
+    hw_set_bits(&hw->dma_cr, I2C_IC_DMA_CR_RDMAE_BITS);
+    slave->rx_dma_enabled = true;
+}
+
+void i2c_slave_disable_rx_dma(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->rx_dma_enabled); // should be called after i2c_slave_enable_rx_dma()
+    assert(!slave->rx_paused);
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw_clear_bits(&hw->dma_cr, I2C_IC_DMA_CR_RDMAE_BITS);
+    dma_channel_abort(slave->rx_dma_channel);
+    dma_channel_unclaim(slave->rx_dma_channel);
+
+    slave->rx_dma_enabled = false;
+    slave->rx_ring = NULL;
+    slave->rx_ring_mask = 0;
+    slave->rx_dma_base = 0;
+    slave->rx_dma_tail = 0;
+
+    // resume serving RX_FULL
+    hw_set_bits(&hw->intr_mask, I2C_IC_INTR_MASK_M_RX_FULL_BITS);
+}
+
+size_t I2C_SLAVE_HOT_FUNC(i2c_slave_rx_dma_available)(i2c_inst_t *i2c) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->rx_dma_enabled);
+
+    return rx_dma_available(slave);
+}
+
+size_t I2C_SLAVE_HOT_FUNC(i2c_slave_rx_dma_read)(i2c_inst_t *i2c, uint8_t *dst, size_t len) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->rx_dma_enabled);
+
+    len = MIN(len, rx_dma_available(slave));
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = slave->rx_ring[slave->rx_dma_tail++ & slave->rx_ring_mask];
+    }
+    if (slave->pec_enabled) {
+        slave->pec = i2c_pec_update_buf(slave->pec, dst, len);
+    }
+    return len;
+}
+
+void i2c_slave_enable_tx_dma(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->i2c == i2c); // should be called after i2c_slave_init()
+    assert(!slave->tx_dma_enabled);
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    slave->tx_dma_channel = (uint)dma_claim_unused_channel(true);
+    slave->tx_dma_active = false;
+    slave->tx_dma_data = NULL;
+    slave->tx_dma_len = 0;
+
+    dma_channel_config c = dma_channel_get_default_config(slave->tx_dma_channel);
+    // Byte writes are replicated across the data bus, so the upper bits of IC_DATA_CMD get a copy
+    // of the data too. Those are CMD / STOP / RESTART, which only have meaning in master mode.
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c, true));
+    dma_channel_configure(slave->tx_dma_channel, &c, &hw->data_cmd, NULL, 0, false);
+
+    // keep the Tx FIFO at least half full while the response buffer is being sent
+    hw->dma_tdlr = 8;
+    hw_set_bits(&hw->dma_cr, I2C_IC_DMA_CR_TDMAE_BITS);
+    slave->tx_dma_enabled = true;
+}
+
+void i2c_slave_disable_tx_dma(i2c_inst_t *i2c) {
+    assert(i2c == i2c0 || i2c == i2c1);
+
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->tx_dma_enabled); // should be called after i2c_slave_enable_tx_dma()
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw_clear_bits(&hw->dma_cr, I2C_IC_DMA_CR_TDMAE_BITS);
+    dma_channel_abort(slave->tx_dma_channel);
+    dma_channel_unclaim(slave->tx_dma_channel);
+
+    slave->tx_dma_enabled = false;
+    slave->tx_dma_active = false;
+    slave->tx_dma_data = NULL;
+    slave->tx_dma_len = 0;
+}
+
+void I2C_SLAVE_HOT_FUNC(i2c_slave_set_tx_dma_buffer)(i2c_inst_t *i2c, const uint8_t *data, size_t len) {
+    i2c_slave_t *slave = &i2c_slaves[i2c_hw_index(i2c)];
+    assert(slave->tx_dma_enabled);
+    assert(data != NULL || len == 0);
+
+    slave->tx_dma_data = data;
+    slave->tx_dma_len = len;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <i2c_slave_queue.h>
+#include <hardware/structs/sio.h>
+#include <hardware/timer.h>
+
+static inline void begin_transaction(i2c_slave_queue_t *queue, i2c_inst_t *i2c, bool is_read) {
+    queue->pending = true;
+    if (queue->head - queue->tail > queue->mask) {
+        queue->discarding = true; // full
+        return;
+    }
+    i2c_slave_transaction_t *txn = &queue->slots[queue->head & queue->mask];
+    txn->timestamp_us = time_us_32();
+    txn->i2c_index = (uint8_t)i2c_hw_index(i2c);
+    txn->address = (uint8_t)i2c_get_hw(i2c)->sar;
+    txn->is_read = is_read;
+    txn->truncated = false;
+    txn->length = 0;
+}
+
+static inline void end_transaction(i2c_slave_queue_t *queue) {
+    queue->pending = false;
+    if (queue->discarding) {
+        queue->discarding = false;
+        queue->dropped = queue->dropped + 1;
+        return;
+    }
+    __dmb(); // fill the slot before publishing it
+    queue->head = queue->head + 1;
+
+    if (queue->doorbell && (sio_hw->fifo_st & SIO_FIFO_ST_RDY_BITS)) {
+        // same as multicore_fifo_push_blocking(), without blocking
+        sio_hw->fifo_wr = queue->doorbell_value;
+        __sev();
+    }
+}
+
+void i2c_slave_queue_init(i2c_slave_queue_t *queue, i2c_slave_transaction_t *slots, uint num_slots) {
+    assert(slots != NULL);
+    assert(num_slots > 0 && (num_slots & (num_slots - 1)) == 0); // must be a power of two
+
+    queue->slots = slots;
+    queue->mask = num_slots - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->dropped = 0;
+    queue->pending = false;
+    queue->discarding = false;
+    queue->doorbell = false;
+    queue->doorbell_value = 0;
+}
+
+void i2c_slave_queue_set_doorbell(i2c_slave_queue_t *queue, bool enabled, uint32_t value) {
+    queue->doorbell = enabled;
+    queue->doorbell_value = value;
+}
+
+void I2C_SLAVE_HOT_FUNC(i2c_slave_queue_handle_event)(i2c_slave_queue_t *queue, i2c_inst_t *i2c,
+    i2c_slave_event_t event) {
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+
+    switch (event) {
+    case I2C_SLAVE_RECEIVE:
+        for (size_t n = i2c_get_read_available(i2c); n > 0; n--) {
+            uint32_t data_cmd = hw->data_cmd;
+            if (queue->pending && (data_cmd & I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS)) {
+                // The previous transfer has finished, but we haven't seen its Stop / Restart yet.
+                // Split on the first byte marker, so transactions never get merged.
+                end_transaction(queue);
+            }
+            if (!queue->pending) {
+                begin_transaction(queue, i2c, false);
+            }
+            if (queue->discarding) {
+                continue;
+            }
+            i2c_slave_transaction_t *txn = &queue->slots[queue->head & queue->mask];
+            if (txn->length < I2C_SLAVE_QUEUE_MAX_DATA) {
+                txn->data[txn->length++] = (uint8_t)data_cmd;
+            } else {
+                txn->truncated = true;
+            }
+        }
+        break;
+    case I2C_SLAVE_REQUEST:
+        if (!queue->pending) {
+            begin_transaction(queue, i2c, true);
+        }
+        break;
+    case I2C_SLAVE_FINISH:
+        if (queue->pending) {
+            end_transaction(queue);
+        }
+        break;
+    default:
+        break;
+    }
+}
@@ -46,6 +46,66 @@ static inline void i2c_write_byte(i2c_inst_t *i2c, uint8_t value) {
     hw->data_cmd = value;
 }
 
+/**
+ * \brief Pop as many bytes as available from I2C Rx FIFO, up to `max`.
+ *
+ * Reads the FIFO level once, then drains it in a single burst. Always inlined, so it runs from
+ * RAM along with the ISR calling it.
+ *
+ * \param i2c I2C instance.
+ * \param dst Destination buffer.
+ * \param max Maximum number of bytes to read.
+ * \return size_t Number of bytes read.
+ */
+static __force_inline size_t i2c_read_bytes(i2c_inst_t *i2c, uint8_t *dst, size_t max) {
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    size_t count = hw->rxflr;
+    if (count > max) {
+        count = max;
+    }
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        dst[i] = (uint8_t)hw->data_cmd;
+        dst[i + 1] = (uint8_t)hw->data_cmd;
+        dst[i + 2] = (uint8_t)hw->data_cmd;
+        dst[i + 3] = (uint8_t)hw->data_cmd;
+    }
+    for (; i < count; i++) {
+        dst[i] = (uint8_t)hw->data_cmd;
+    }
+    return count;
+}
+
+/**
+ * \brief Push as many bytes as fit into I2C Tx FIFO, up to `max`.
+ *
+ * Reads the FIFO level once, then fills it in a single burst. Always inlined, so it runs from
+ * RAM along with the ISR calling it.
+ *
+ * \param i2c I2C instance.
+ * \param src Source buffer.
+ * \param max Maximum number of bytes to write.
+ * \return size_t Number of bytes written.
+ */
+static __force_inline size_t i2c_write_bytes(i2c_inst_t *i2c, const uint8_t *src, size_t max) {
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    size_t count = i2c_get_write_available(i2c);
+    if (count > max) {
+        count = max;
+    }
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        hw->data_cmd = src[i];
+        hw->data_cmd = src[i + 1];
+        hw->data_cmd = src[i + 2];
+        hw->data_cmd = src[i + 3];
+    }
+    for (; i < count; i++) {
+        hw->data_cmd = src[i];
+    }
+    return count;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _I2C_PEC_H_
+#define _I2C_PEC_H_
+
+#include <pico.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file i2c_pec.h
+ *
+ * \brief SMBus Packet Error Code (CRC-8, polynomial x^8 + x^2 + x + 1).
+ *
+ * PEC covers every byte of an SMBus transaction, address bytes included, and starts from 0. It
+ * is computed one byte at a time with a 256 byte table kept in RAM, so it can run from the I2C
+ * ISR as data goes through the FIFOs. A message followed by its own PEC byte checks out to 0.
+ */
+
+/**
+ * \brief CRC-8 lookup table, indexed by `pec ^ byte`.
+ */
+extern const uint8_t i2c_pec_table[256];
+
+/**
+ * \brief Add a byte to a running PEC.
+ *
+ * \param pec PEC of the preceding bytes, or 0 at the start of a transaction.
+ * \param byte Next byte.
+ * \return uint8_t Updated PEC.
+ */
+static inline uint8_t i2c_pec_update(uint8_t pec, uint8_t byte) {
+    return i2c_pec_table[pec ^ byte];
+}
+
+/**
+ * \brief Add a buffer to a running PEC.
+ *
+ * \param pec PEC of the preceding bytes, or 0 at the start of a transaction.
+ * \param data Next bytes.
+ * \param len Number of bytes.
+ * \return uint8_t Updated PEC.
+ */
+static inline uint8_t i2c_pec_update_buf(uint8_t pec, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        pec = i2c_pec_table[pec ^ data[i]];
+    }
+    return pec;
+}
+
+/**
+ * \brief Get the address byte sent by master, as covered by PEC.
+ *
+ * \param address 7-bit slave address.
+ * \param read True for a read, false for a write.
+ * \return uint8_t Address byte.
+ */
+static inline uint8_t i2c_pec_address_byte(uint8_t address, bool read) {
+    return (uint8_t)((address << 1) | (read ? 1 : 0));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _I2C_PEC_H_
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _I2C_REGMAP_H_
+#define _I2C_REGMAP_H_
+
+#include <i2c_slave.h>
+#include <hardware/sync.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file i2c_regmap.h
+ *
+ * \brief I2C slave register map.
+ *
+ * Implements the common slave protocol where the master first writes a register address,
+ * followed by data. The address is automatically incremented for each byte transferred.
+ * Reading is done sequentially from the current register address. The whole protocol is
+ * handled from the I2C ISR, draining / filling the FIFO on each interrupt.
+ */
+
+/**
+ * \brief Register range flags.
+ */
+enum i2c_regmap_range_flags
+{
+    I2C_REGMAP_READ_ONLY = 1u << 0, /**< Writes from master are ignored. */
+};
+
+/**
+ * \brief Number of words in a dirty bitmap, see `i2c_regmap_config_t::dirty`.
+ *
+ * \param num_registers Register map size, divided by the register width.
+ */
+#define I2C_REGMAP_DIRTY_WORDS(num_registers) (((num_registers) + 31) / 32)
+
+struct i2c_regmap_t;
+
+/**
+ * \brief No status register for a stream, see `i2c_regmap_stream_t`.
+ */
+#define I2C_REGMAP_NO_STATUS 0xffffffffu
+
+/**
+ * \brief A FIFO register, backed by a ring buffer. Use `i2c_regmap_stream_init()`.
+ *
+ * When master sets the register address to `reg`, the address stops auto-incrementing and
+ * transfers go through the ring instead of register memory. For streams master reads from, the
+ * application produces data with `i2c_regmap_stream_write()`, and the ISR sends it in bursts. An
+ * empty ring is answered with 0xFF and counted as an underrun. For streams master writes to, the
+ * ISR fills the ring, and the application consumes it with `i2c_regmap_stream_read()`. Data not
+ * fitting in the ring is dropped and counted as an overrun.
+ *
+ * If `status_reg` is set, 4 registers from there hold the stream status, refreshed at the start of
+ * each read: the level as 16-bit little-endian (bytes ready for master to read, or free space for
+ * master to write), followed by the underrun and overrun counts modulo 256.
+ */
+typedef struct i2c_regmap_stream_t
+{
+    uint32_t reg; /**< FIFO register address. */
+    uint32_t status_reg; /**< Status register address, or I2C_REGMAP_NO_STATUS. */
+    bool master_reads; /**< Direction, master reads from the stream or writes to it. */
+    uint8_t *buf;
+    uint32_t mask; // ring size - 1
+    volatile uint32_t head; // written by producer
+    volatile uint32_t tail; // written by consumer
+    uint32_t read_pos; // sent to master, but only consumed once the transaction finishes
+    uint32_t sent_since_pad;
+    volatile uint32_t underruns; /**< Bytes padded, because the ring was empty. */
+    volatile uint32_t overruns; /**< Bytes dropped, because the ring was full. */
+} i2c_regmap_stream_t;
+
+/**
+ * \brief Called from the I2C ISR when master has finished writing registers in a range.
+ *
+ * Runs once per transaction, after Stop / Restart, with the part of the range that was written.
+ * As with other slave handlers, it should return quickly.
+ *
+ * \param regmap Register map.
+ * \param start First register written.
+ * \param count Number of registers written.
+ */
+typedef void (*i2c_regmap_write_hook_t)(struct i2c_regmap_t *regmap, uint32_t start, uint32_t count);
+
+/**
+ * \brief A range of registers with common access flags.
+ */
+typedef struct i2c_regmap_range_t
+{
+    uint32_t start; /**< First register in the range. */
+    uint32_t size; /**< Number of registers in the range. */
+    uint32_t flags; /**< Combination of i2c_regmap_range_flags. */
+    i2c_regmap_write_hook_t on_write; /**< Optional, called after master writes into the range. */
+} i2c_regmap_range_t;
+
+/**
+ * \brief Register map configuration.
+ */
+typedef struct i2c_regmap_config_t
+{
+    /** Register memory, one byte per register. The application may access it directly, unless
+        there is a `shadow` bank. */
+    uint8_t *mem;
+    /** Number of registers, up to 65536. */
+    uint32_t size;
+    /** Register address width in bytes, 1 or 2. 16-bit addresses are sent MSB first. */
+    uint8_t address_width;
+    /**
+     * Multi-byte register width, 1, 2, 4 or 8. Registers are aligned to their width.
+     *
+     * A master write is committed to memory only once a whole register has been received, and a
+     * master read takes a snapshot of the whole register when reaching its first byte. Registers up
+     * to 4 bytes are copied with a single load / store, so they are also consistent with aligned
+     * accesses from the application. `mem` must be aligned to the register width.
+     */
+    uint8_t register_width;
+    /** When reaching the end, wrap around to register 0 if true. Otherwise, reads past the end
+        return 0xFF and writes are ignored. */
+    bool wrap;
+    /** Ranges with custom access. */
+    const i2c_regmap_range_t *ranges;
+    /** Number of ranges. */
+    uint num_ranges;
+    /**
+     * Optional second register bank, the same size and alignment as `mem`.
+     *
+     * With two banks, the ISR serves each transaction from the bank which was current when it
+     * started, so master always sees a consistent snapshot. The application must then update
+     * registers only through `i2c_regmap_begin_update()` / `i2c_regmap_end_update()`.
+     */
+    uint8_t *shadow;
+    /**
+     * Optional dirty bitmap, `I2C_REGMAP_DIRTY_WORDS(size / register_width)` words with one bit
+     * per register. Bit `n` stands for the register starting at `n * register_width`.
+     *
+     * Bits are set when master writes a register, once the transaction finishes. The application
+     * collects them with `i2c_regmap_take_dirty()`, so it only has to look at registers which
+     * changed.
+     */
+    uint32_t *dirty;
+    /** FIFO registers. They must stay valid while the slave is running. */
+    i2c_regmap_stream_t *streams;
+    /** Number of FIFO registers. */
+    uint num_streams;
+    /**
+     * After a write of just the register address, stage the first bytes a read would return
+     * from there, so a read following with a Restart isn't clock stretched (see
+     * `i2c_slave_prefill()`).
+     *
+     * The staged bytes are a snapshot taken at the Restart, a few bit times before master reads
+     * them. If master sends Stop instead, they're discarded. Not used for FIFO registers, and not
+     * available together with PEC or DMA transmit.
+     *
+     * Ignored with a `shadow` bank. The bank is released when the address write finishes, so a
+     * read longer than the staged bytes could mix two snapshots, and keeping it pinned across the
+     * Restart would block `i2c_regmap_begin_update()` until the next transaction if master sent
+     * Stop instead.
+     */
+    bool prefill;
+} i2c_regmap_config_t;
+
+/**
+ * \brief Register map state. Treat as opaque.
+ */
+typedef struct i2c_regmap_t
+{
+    i2c_regmap_config_t config;
+    uint8_t *mem; // bank served by the ISR
+    volatile uint8_t front; // most recently published bank, written by application
+    volatile uint8_t pinned; // bank used by the current transaction, written by ISR
+    bool has_write_hooks;
+    bool read_started; // stream status has been refreshed, and the address moved past staged bytes
+    i2c_regmap_stream_t *stream; // selected by the current register address
+    uint32_t write_start; // first register written in the current transaction
+    uint32_t write_span; // bytes from write_start to the end of the last register written
+    uint32_t write_bytes; // bytes committed in the current transaction
+    spin_lock_t *dirty_lock;
+    uint32_t address; // current register address, may go past the end if not wrapping
+    uint32_t pending_address; // register address being received
+    uint8_t address_bytes; // address bytes received in the current write
+    bool address_only; // the current write has been just the register address so far
+    bool latch_valid;
+    uint32_t latch_address; // first register in latch
+    uint8_t latch[8] __attribute__((aligned(8)));
+} i2c_regmap_t;
+
+/**
+ * \brief Get the default register map configuration.
+ *
+ * 8-bit addressing, single byte registers, wrapping at the end and no protected ranges.
+ *
+ * \param mem Register memory.
+ * \param size Number of registers.
+ */
+i2c_regmap_config_t i2c_regmap_get_default_config(uint8_t *mem, uint32_t size);
+
+/**
+ * \brief Initialize a register map.
+ *
+ * \param regmap Register map state.
+ * \param config Configuration, copied into `regmap`.
+ */
+void i2c_regmap_init(i2c_regmap_t *regmap, const i2c_regmap_config_t *config);
+
+/**
+ * \brief Start updating registers, with a shadow bank.
+ *
+ * Returns the back bank, holding a copy of the current registers. Make changes there, and
+ * call `i2c_regmap_end_update()` to publish them all at once. Neither side takes a lock or
+ * masks the I2C interrupt. If a transaction which started before the previous update is still
+ * reading the back bank, this waits for it to finish.
+ *
+ * Master writes go to the bank being served, and are carried over by the copy made here. Those
+ * arriving while the update is in progress are lost when it's published.
+ *
+ * Call from one thread at a time.
+ *
+ * \param regmap Register map with `shadow` set.
+ * \return Register memory to update.
+ */
+uint8_t *i2c_regmap_begin_update(i2c_regmap_t *regmap);
+
+/**
+ * \brief Publish the registers updated since `i2c_regmap_begin_update()`.
+ *
+ * Transactions starting after this see the new registers. Those in progress finish on the
+ * previous snapshot.
+ *
+ * \param regmap Register map with `shadow` set.
+ */
+void i2c_regmap_end_update(i2c_regmap_t *regmap);
+
+/**
+ * \brief Collect and clear the dirty bitmap.
+ *
+ * May be called from either core, while the slave is running.
+ *
+ * \param regmap Register map with `dirty` set.
+ * \param dirty Receives `I2C_REGMAP_DIRTY_WORDS(size / register_width)` words, with the
+ *              registers written since the previous call.
+ * \return Whether any register was written.
+ */
+bool i2c_regmap_take_dirty(i2c_regmap_t *regmap, uint32_t *dirty);
+
+/**
+ * \brief Initialize a FIFO register.
+ *
+ * Set `status_reg` afterwards, to report the stream status to master.
+ *
+ * \param stream Stream state.
+ * \param reg FIFO register address.
+ * \param master_reads True if master reads from the stream, false if it writes to it.
+ * \param buf Ring buffer.
+ * \param size Ring buffer size, must be a power of two.
+ */
+void i2c_regmap_stream_init(i2c_regmap_stream_t *stream, uint32_t reg, bool master_reads, uint8_t *buf,
+    uint32_t size);
+
+/**
+ * \brief Queue data for master to read. Producer side, call from one thread.
+ *
+ * \param stream Stream which master reads from.
+ * \param data Data to queue.
+ * \param len Data size.
+ * \return The amount of data queued. May be less than `len` if the ring fills up.
+ */
+size_t i2c_regmap_stream_write(i2c_regmap_stream_t *stream, const uint8_t *data, size_t len);
+
+/**
+ * \brief Take data written by master. Consumer side, call from one thread.
+ *
+ * \param stream Stream which master writes to.
+ * \param data Receives the data.
+ * \param len Maximum amount to take.
+ * \return The amount of data taken.
+ */
+size_t i2c_regmap_stream_read(i2c_regmap_stream_t *stream, uint8_t *data, size_t len);
+
+/**
+ * \brief Get the number of bytes in the ring.
+ *
+ * \param stream Stream state.
+ */
+static inline uint32_t i2c_regmap_stream_level(const i2c_regmap_stream_t *stream) {
+    return stream->head - stream->tail;
+}
+
+/**
+ * \brief Configure I2C instance for slave mode, serving a register map.
+ *
+ * Use `i2c_slave_deinit()` to restore master mode.
+ *
+ * \param i2c I2C instance.
+ * \param address 7-bit slave address.
+ * \param regmap Initialized register map. Must stay valid until `i2c_slave_deinit()`.
+ */
+void i2c_regmap_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_regmap_t *regmap);
+
+/**
+ * \brief Configure I2C instance for slave mode, serving a register map, with custom settings.
+ *
+ * SMBus PEC (`i2c_slave_config_t::pec`) is not supported. The register map moves data through
+ * the FIFOs directly, and reads wrap around the map rather than ending, so there is no point at
+ * which to append a PEC byte.
+ *
+ * \param i2c I2C instance.
+ * \param address 7-bit slave address.
+ * \param regmap Initialized register map. Must stay valid until `i2c_slave_deinit()`.
+ * \param config Slave configuration.
+ */
+void i2c_regmap_slave_init_with_config(i2c_inst_t *i2c, uint8_t address, i2c_regmap_t *regmap,
+    const i2c_slave_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _I2C_REGMAP_H_
@@ -8,6 +8,7 @@
 #define _I2C_SLAVE_H_
 
 #include <hardware/i2c.h>
+#include <hardware/irq.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,20 +19,87 @@ extern "C" {
  * \brief I2C slave setup.
  */
 
+/**
+ * \brief Enable ISR latency profiling.
+ *
+ * Define as 1 for the target linking i2c_slave to collect timings from the I2C ISR, see
+ * `i2c_slave_get_profile()`. There is a small overhead on every event.
+ */
+#ifndef I2C_SLAVE_PROFILE
+#define I2C_SLAVE_PROFILE 0
+#endif
+
+/**
+ * \brief Enable the ISR event trace.
+ *
+ * Define as 1 for the target linking i2c_slave to record ISR events into a RAM ring, see
+ * `i2c_slave_trace_dump()`. Each record costs a few cycles, instead of the milliseconds it takes
+ * to print from the handler.
+ */
+#ifndef I2C_SLAVE_TRACE
+#define I2C_SLAVE_TRACE 0
+#endif
+
+/**
+ * \brief Number of records in the trace ring of each slave, a power of two.
+ */
+#ifndef I2C_SLAVE_TRACE_LENGTH
+#define I2C_SLAVE_TRACE_LENGTH 128
+#endif
+
+/**
+ * \brief Placement of the slave hot path.
+ *
+ * The ISR, slave state and register map engine run from RAM. With I2C_SLAVE_SCRATCH_X or
+ * I2C_SLAVE_SCRATCH_Y defined as 1, they go into that scratch bank instead, away from SRAM
+ * accesses by the other core. Set the I2C_SLAVE_SCRATCH_BANK property of the executable to X or
+ * Y, rather than defining these directly.
+ *
+ * By default the scratch banks also hold the core stacks: core 0 at the top of SCRATCH_Y and
+ * core 1 at the top of SCRATCH_X. Pick the bank of the core running the ISR, and mind the space
+ * left below its stack.
+ *
+ * Handlers, and the state they touch from the ISR, can be placed alongside with
+ * `I2C_SLAVE_HOT_FUNC()` / `I2C_SLAVE_HOT_DATA()`. Code inlined into them (like `i2c_fifo.h`)
+ * follows automatically. GCC ignores section attributes on template members, so place a plain
+ * function instead and inline the template code into it, as `I2C_SLAVE_DEFINE_IRQ_HANDLER()`
+ * does. `i2c_slave_check_hot_path()` in CMake checks the result in the link map.
+ */
+#if I2C_SLAVE_SCRATCH_X
+#define I2C_SLAVE_HOT(group) __scratch_x(group)
+#define I2C_SLAVE_HOT_DATA(group) __scratch_x(group)
+#elif I2C_SLAVE_SCRATCH_Y
+#define I2C_SLAVE_HOT(group) __scratch_y(group)
+#define I2C_SLAVE_HOT_DATA(group) __scratch_y(group)
+#else
+/** \brief Place a function on the slave hot path, as with `__not_in_flash()`. */
+#define I2C_SLAVE_HOT(group) __not_in_flash(group)
+/** \brief Place a variable on the slave hot path. Plain SRAM unless a scratch bank is selected. */
+#define I2C_SLAVE_HOT_DATA(group)
+#endif
+
+/** \brief Place a function on the slave hot path, as with `__not_in_flash_func()`. */
+#define I2C_SLAVE_HOT_FUNC(func) I2C_SLAVE_HOT(#func) func
+
 /**
  * \brief I2C slave event types.
  */
 typedef enum i2c_slave_event_t
 {
-    I2C_SLAVE_RECEIVE, /**< Data from master is available for reading. Slave must read from Rx FIFO. */
-    I2C_SLAVE_REQUEST, /**< Master is requesting data. Slave must write into Tx FIFO. */
+    I2C_SLAVE_RECEIVE, /**< Data from master is available for reading. Slave must read from Rx FIFO, or from
+                            the ring buffer if DMA receive is enabled. */
+    I2C_SLAVE_REQUEST, /**< Master is requesting data. Slave must write into Tx FIFO. Not raised while
+                            DMA transmit is sending the response buffer. */
     I2C_SLAVE_FINISH, /**< Master has sent a Stop or Restart signal. Slave may prepare for the next transfer. */
+    I2C_SLAVE_REFILL, /**< Streaming transmit only. Tx FIFO has drained down to the Tx threshold during a
+                           read. Slave may write more data into Tx FIFO, or nothing if the response is complete. */
 } i2c_slave_event_t;
 
 /**
  * \brief I2C slave event handler
  * 
- * The event handler will run from the I2C ISR, so it should return quickly (under 25 us at 400 kb/s).
+ * The event handler will run from the I2C ISR, so it should return quickly (under 25 us at 400 kb/s,
+ * or 10 us at 1 Mb/s).
  * Avoid blocking inside the handler and split large data transfers across multiple calls for best results.
  * When sending data to master, up to `i2c_get_write_available()` bytes can be written without blocking.
  * When receiving data from master, up to `i2c_get_read_available()` bytes can be read without blocking.
@@ -41,6 +109,135 @@ typedef enum i2c_slave_event_t
  */
 typedef void (*i2c_slave_handler_t)(i2c_inst_t *i2c, i2c_slave_event_t event);
 
+/**
+ * \brief Callback for a single I2C slave event.
+ *
+ * Runs from the I2C ISR, with the same constraints as `i2c_slave_handler_t`.
+ *
+ * \param i2c Slave I2C instance.
+ * \param user Context pointer from `i2c_slave_callbacks_t`.
+ */
+typedef void (*i2c_slave_callback_t)(i2c_inst_t *i2c, void *user);
+
+/**
+ * \brief Per-event callbacks, an alternative to a single `i2c_slave_handler_t`.
+ *
+ * Events without a callback are skipped by the ISR. Without `receive`, data written by master is
+ * read and discarded. Note that a read is clock stretched until something is written into the Tx
+ * FIFO, so leave `request` NULL only when replying from Tx DMA.
+ */
+typedef struct i2c_slave_callbacks_t
+{
+    i2c_slave_callback_t receive; /**< I2C_SLAVE_RECEIVE */
+    i2c_slave_callback_t request; /**< I2C_SLAVE_REQUEST */
+    i2c_slave_callback_t finish; /**< I2C_SLAVE_FINISH */
+    i2c_slave_callback_t refill; /**< I2C_SLAVE_REFILL. If NULL, streaming stops after I2C_SLAVE_REQUEST. */
+    /** Optional. A transfer has started, called before its first I2C_SLAVE_RECEIVE or
+        I2C_SLAVE_REQUEST. */
+    i2c_slave_callback_t start;
+    void *user; /**< Passed to each callback. */
+} i2c_slave_callbacks_t;
+
+/**
+ * \brief I2C slave configuration.
+ */
+typedef struct i2c_slave_config_t
+{
+    /**
+     * Number of bytes in the Rx FIFO which trigger I2C_SLAVE_RECEIVE, between 1 and 16.
+     *
+     * Higher values batch incoming data, reducing the interrupt rate for bulk writes. Whatever is
+     * left in the Rx FIFO below the threshold is delivered when the transfer finishes, right before
+     * I2C_SLAVE_FINISH. Note the handler must then keep up with a FIFO that is almost full, since
+     * there are only `16 - rx_threshold` bytes of headroom left.
+     */
+    uint8_t rx_threshold;
+    /**
+     * Tx FIFO level which triggers I2C_SLAVE_REFILL in streaming transmit mode, between 0 and 15.
+     */
+    uint8_t tx_threshold;
+    /**
+     * Enable streaming transmit.
+     *
+     * The handler may fill the Tx FIFO (up to `i2c_get_write_available()` bytes) on
+     * I2C_SLAVE_REQUEST. Then, while master keeps reading, it gets I2C_SLAVE_REFILL each time the
+     * Tx FIFO drains down to `tx_threshold`, so long responses go out without clock stretching.
+     * Streaming stops once the handler has nothing more to write, or when master NACKs the last
+     * byte. Bytes left in the Tx FIFO at the end of the transfer are not sent, see
+     * `i2c_slave_get_tx_unsent()`.
+     */
+    bool tx_streaming;
+    /**
+     * Hold the bus while the Rx FIFO is full (IC_CON.RX_FIFO_FULL_HLD_CTRL).
+     *
+     * Master is clock stretched until there is room in the Rx FIFO again, instead of the byte being
+     * dropped. This makes receive lossless, at the rate the handler can sustain. It's required
+     * for `i2c_slave_pause_rx()` to hold off master writes, rather than lose data.
+     */
+    bool rx_hold_bus;
+    /**
+     * CPU core which runs the I2C ISR, and therefore the handler.
+     *
+     * Defaults to the core calling `i2c_slave_get_default_config()`. To run the ISR on the other
+     * core, `i2c_slave_enable_irq()` must be called from there once initialization is done. Until
+     * then, events from master are left pending.
+     */
+    uint8_t irq_core;
+    /**
+     * NVIC priority of the I2C interrupt, as for `irq_set_priority()`. Lower values are more urgent.
+     */
+    uint8_t irq_priority;
+    /**
+     * Data setup time when transmitting (IC_SDA_SETUP), in ns. SCL is held low for this long after
+     * SDA changes. 0 keeps the reset value, which is 100 clk_sys cycles (0.8 us at 125 MHz), and
+     * too long for 1 Mb/s.
+     */
+    uint16_t sda_setup_ns;
+    /**
+     * Data hold time when transmitting (IC_SDA_HOLD), in ns. SDA changes this long after SCL
+     * falls. 0 keeps the value set by `i2c_init()` for its baudrate.
+     */
+    uint16_t sda_hold_ns;
+    /**
+     * Longest spike suppressed on SDA / SCL (IC_FS_SPKLEN), in ns. 0 keeps the value set by
+     * `i2c_init()` for its baudrate.
+     */
+    uint16_t spike_ns;
+    /**
+     * Track the SMBus Packet Error Code (see `i2c_pec.h`).
+     *
+     * The slave accumulates PEC over the address bytes and over all data moved with
+     * `i2c_slave_read()`, `i2c_slave_write()`, `i2c_slave_rx_dma_read()` and DMA transmit, from
+     * one Stop to the next. Handlers must use these rather than accessing the FIFOs directly.
+     *
+     * On reads, the PEC byte is appended automatically once the handler writes nothing on
+     * I2C_SLAVE_REQUEST, that is once the response is complete. On writes, the PEC byte from
+     * master is delivered as data, and `i2c_slave_is_pec_valid()` tells on I2C_SLAVE_FINISH
+     * whether it checks out.
+     */
+    bool pec;
+} i2c_slave_config_t;
+
+/**
+ * \brief Get the default I2C slave configuration.
+ *
+ * I2C_SLAVE_RECEIVE is raised for every byte, and the ISR runs on the calling core at default
+ * priority, as with `i2c_slave_init()`.
+ */
+i2c_slave_config_t i2c_slave_get_default_config(void);
+
+/**
+ * \brief Get a slave configuration for Fast-mode Plus (1 Mb/s).
+ *
+ * Sets bus timings to the FM+ limits, independent of the baudrate given to `i2c_init()`, and
+ * batches FIFO accesses with streaming transmit. The handler must drain / fill the FIFO up to the
+ * available level on each event, and must be fast enough for a byte every 9 us.
+ *
+ * Timings are derived from `clk_sys`, so call `i2c_slave_init_with_config()` after changing the
+ * system clock.
+ */
+i2c_slave_config_t i2c_slave_get_fast_mode_plus_config(void);
+
 /**
  * \brief Configure I2C instance for slave mode.
  * 
@@ -51,13 +248,441 @@ typedef void (*i2c_slave_handler_t)(i2c_inst_t *i2c, i2c_slave_event_t event);
  */
 void i2c_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handler);
 
+/**
+ * \brief Configure I2C instance for slave mode, with custom settings.
+ *
+ * \param i2c I2C instance.
+ * \param address 7-bit slave address.
+ * \param handler Called on events from I2C master. It will run from the I2C ISR, on the CPU core
+ *                set in `config`.
+ * \param config Slave configuration.
+ */
+void i2c_slave_init_with_config(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handler,
+    const i2c_slave_config_t *config);
+
+/**
+ * \brief Configure I2C instance for slave mode, with per-event callbacks.
+ *
+ * Same as `i2c_slave_init_with_config()`, except that each event goes straight to its own
+ * callback, along with a context pointer.
+ *
+ * \param i2c I2C instance.
+ * \param address 7-bit slave address.
+ * \param callbacks Event callbacks, copied by the slave. They will run from the I2C ISR, on the
+ *                  CPU core set in `config`.
+ * \param config Slave configuration.
+ */
+void i2c_slave_init_with_callbacks(i2c_inst_t *i2c, uint8_t address, const i2c_slave_callbacks_t *callbacks,
+    const i2c_slave_config_t *config);
+
+/**
+ * \brief Configure I2C instance for slave mode, serviced by a custom ISR.
+ *
+ * The hardware is set up as for `i2c_slave_init_with_config()`, but `irq_handler` takes over
+ * the I2C interrupt, see `i2c_slave.hpp`. Statistics, profiling, DMA and PEC are left to the
+ * custom ISR, so they are not available from this API.
+ *
+ * \param i2c I2C instance.
+ * \param address 7-bit slave address.
+ * \param irq_handler Installed as the exclusive I2C interrupt handler, until `i2c_slave_deinit()`.
+ * \param config Slave configuration.
+ */
+void i2c_slave_init_with_irq_handler(i2c_inst_t *i2c, uint8_t address, irq_handler_t irq_handler,
+    const i2c_slave_config_t *config);
+
+/**
+ * \brief Enable the I2C interrupt on the current core.
+ *
+ * Only needed when the slave was initialized with `irq_core` set to a different core than the
+ * one calling `i2c_slave_init_with_config()`. Must be called from `irq_core`.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_enable_irq(i2c_inst_t *i2c);
+
 /**
  * \brief Restore I2C instance to master mode.
  *
+ * Must be called from the core which runs the I2C ISR.
+ *
  * \param i2c I2C instance.
  */
 void i2c_slave_deinit(i2c_inst_t *i2c);
 
+/**
+ * \brief Get the number of bytes written into the Tx FIFO which master didn't read.
+ *
+ * Valid during I2C_SLAVE_FINISH, for the transfer that has just finished. Handlers which fill the
+ * Tx FIFO ahead of time can use it to find out how much of their data was actually sent.
+ *
+ * \param i2c Slave I2C instance.
+ * \return The number of unsent bytes.
+ */
+uint i2c_slave_get_tx_unsent(i2c_inst_t *i2c);
+
+/**
+ * \brief Pop as many bytes as available from the Rx FIFO, up to `max`.
+ *
+ * Same as `i2c_read_bytes()`, and also adds the data to the running PEC when enabled.
+ *
+ * \param i2c Slave I2C instance.
+ * \param dst Destination buffer.
+ * \param max Maximum number of bytes to read.
+ * \return The number of bytes read.
+ */
+size_t i2c_slave_read(i2c_inst_t *i2c, uint8_t *dst, size_t max);
+
+/**
+ * \brief Push as many bytes as fit into the Tx FIFO, up to `max`.
+ *
+ * Same as `i2c_write_bytes()`, and also adds the data to the running PEC when enabled.
+ *
+ * \param i2c Slave I2C instance.
+ * \param src Source buffer.
+ * \param max Maximum number of bytes to write.
+ * \return The number of bytes written.
+ */
+size_t i2c_slave_write(i2c_inst_t *i2c, const uint8_t *src, size_t max);
+
+/**
+ * \brief Check the PEC of the data written by master.
+ *
+ * Available when `i2c_slave_config_t::pec` is enabled. Valid during I2C_SLAVE_FINISH, after a
+ * transfer written by master. True if the SMBus transaction so far, ending with the last byte
+ * received (the PEC byte), checks out. Only meaningful at the end of the transaction: after the
+ * command part of a combined write / read, there is no PEC byte yet.
+ *
+ * \param i2c Slave I2C instance.
+ */
+bool i2c_slave_is_pec_valid(i2c_inst_t *i2c);
+
+/**
+ * \brief Maximum size of a staged response, see `i2c_slave_prefill()`. Same as the Tx FIFO depth.
+ */
+#define I2C_SLAVE_PREFILL_MAX 16
+
+/**
+ * \brief Stage the predicted response for a read following this write with a Restart.
+ *
+ * Meant for the "write register address, Restart, read" pattern. The Tx FIFO can't be loaded
+ * ahead of the read, since DW_apb_i2c flushes it when master addresses a read. Instead, the ISR
+ * pushes the staged bytes as the first thing on RD_REQ, before finishing the write or running
+ * the handler, so master is stretched only for as long as it takes to enter the ISR.
+ *
+ * Must be called from the handler, typically on I2C_SLAVE_FINISH of a write which only set the
+ * register address. I2C_SLAVE_REQUEST is not raised for the staged bytes, the handler only hears about
+ * the data after them, and should skip `i2c_slave_get_tx_prefilled()` bytes first. If the
+ * prediction turns out wrong, the staged bytes are discarded unsent: on Stop, or when master
+ * starts another write.
+ *
+ * Not available with PEC, DMA transmit, nor with a custom ISR.
+ *
+ * \param i2c Slave I2C instance.
+ * \param data Predicted response.
+ * \param len Number of bytes, up to I2C_SLAVE_PREFILL_MAX. 0 discards the staged response.
+ */
+void i2c_slave_prefill(i2c_inst_t *i2c, const uint8_t *data, size_t len);
+
+/**
+ * \brief Get the number of staged bytes pushed into the Tx FIFO when the current read started.
+ *
+ * Valid during I2C_SLAVE_REQUEST, I2C_SLAVE_REFILL and I2C_SLAVE_FINISH, see
+ * `i2c_slave_prefill()`. Bytes master didn't read count towards `i2c_slave_get_tx_unsent()` as
+ * usual.
+ *
+ * \param i2c Slave I2C instance.
+ * \return The number of staged bytes sent, or 0.
+ */
+uint i2c_slave_get_tx_prefilled(i2c_inst_t *i2c);
+
+/**
+ * \brief Stop delivering events to the handler, to apply back-pressure on master.
+ *
+ * Meant for a consumer outside the ISR (for example of `i2c_slave_queue_t`) whose buffer is
+ * nearly full. Received data is left in the Rx FIFO, and once that fills up master is held by
+ * clock stretching, as long as the slave was initialized with `rx_hold_bus`. Start / Stop signals
+ * and read requests are left pending as well, so reads are stretched too. Call
+ * `i2c_slave_resume_rx()` to deliver the pending events, in order.
+ *
+ * Takes effect once the ISR returns, if it's already running on the other core. Master may give
+ * up (for example on SMBus timeout) if the bus is held for too long. Several transfers may arrive
+ * while paused, in which case the handler only sees a single I2C_SLAVE_FINISH for them. Handlers
+ * which need transfer boundaries should look for I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS, as
+ * `i2c_slave_queue_handle_event()` does.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_pause_rx(i2c_inst_t *i2c);
+
+/**
+ * \brief Resume delivering events to the handler, after `i2c_slave_pause_rx()`.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_resume_rx(i2c_inst_t *i2c);
+
+/**
+ * \brief Check if receive is paused.
+ *
+ * \param i2c Slave I2C instance.
+ */
+bool i2c_slave_is_rx_paused(i2c_inst_t *i2c);
+
+/**
+ * \brief Drain the Rx FIFO into a ring buffer using DMA.
+ *
+ * Instead of raising I2C_SLAVE_RECEIVE for every byte (or FIFO threshold), a DMA channel paced by
+ * the I2C Rx DREQ collects incoming data into `ring`. I2C_SLAVE_RECEIVE is then raised once per
+ * transfer, right before I2C_SLAVE_FINISH, with the whole transfer already available through
+ * `i2c_slave_rx_dma_read()`. The handler should consume all of it, since anything left over is
+ * reported together with the next transfer.
+ *
+ * If the handler falls behind by more than the ring size, the oldest data is overwritten.
+ *
+ * \param i2c Slave I2C instance, already initialized with `i2c_slave_init()`.
+ * \param ring Ring buffer, which must be aligned to its size.
+ * \param ring_size_bits Ring buffer size as a power of two, between 1 and 15 (32 KiB).
+ */
+void i2c_slave_enable_rx_dma(i2c_inst_t *i2c, uint8_t *ring, uint ring_size_bits);
+
+/**
+ * \brief Stop using DMA for receive, and release the DMA channel.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_disable_rx_dma(i2c_inst_t *i2c);
+
+/**
+ * \brief Get the amount of received data waiting in the ring buffer.
+ *
+ * Available when DMA receive is enabled.
+ *
+ * \param i2c Slave I2C instance.
+ * \return The number of bytes that can be read with `i2c_slave_rx_dma_read()`.
+ */
+size_t i2c_slave_rx_dma_available(i2c_inst_t *i2c);
+
+/**
+ * \brief Read received data from the ring buffer.
+ *
+ * Available when DMA receive is enabled.
+ *
+ * \param i2c Slave I2C instance.
+ * \param dst Destination buffer.
+ * \param len Maximum amount of data to read.
+ * \return The amount of data read.
+ */
+size_t i2c_slave_rx_dma_read(i2c_inst_t *i2c, uint8_t *dst, size_t len);
+
+/**
+ * \brief Feed the Tx FIFO from a response buffer using DMA.
+ *
+ * With a response buffer set by `i2c_slave_set_tx_dma_buffer()`, a read request from master
+ * starts a DMA channel paced by the I2C Tx DREQ. The whole buffer is then sent at line rate,
+ * without I2C_SLAVE_REQUEST events and without clock stretching after the first byte. If master
+ * reads past the end of the buffer, I2C_SLAVE_REQUEST is raised as usual for the extra bytes.
+ *
+ * \param i2c Slave I2C instance, already initialized with `i2c_slave_init()`.
+ */
+void i2c_slave_enable_tx_dma(i2c_inst_t *i2c);
+
+/**
+ * \brief Stop using DMA for transmit, and release the DMA channel.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_disable_tx_dma(i2c_inst_t *i2c);
+
+/**
+ * \brief Set the response buffer for DMA transmit.
+ *
+ * Available when DMA transmit is enabled.
+ *
+ * The buffer stays armed until replaced, and is sent from the start for each read transfer. It
+ * must remain valid and unchanged while a transfer is in progress, so the best place to replace
+ * it is from the handler, on I2C_SLAVE_FINISH.
+ *
+ * \param i2c Slave I2C instance.
+ * \param data Response data, or NULL to rely on I2C_SLAVE_REQUEST only.
+ * \param len Response size.
+ */
+void i2c_slave_set_tx_dma_buffer(i2c_inst_t *i2c, const uint8_t *data, size_t len);
+
+/**
+ * \brief Number of abort sources in IC_TX_ABRT_SOURCE, from ABRT_7B_ADDR_NOACK (bit 0) to
+ * ABRT_USER_ABRT (bit 16).
+ */
+#define I2C_SLAVE_TX_ABORT_SOURCES 17
+
+/**
+ * \brief I2C slave statistics.
+ *
+ * Counters start from zero on `i2c_slave_init()` and wrap around, so compare successive readings.
+ */
+typedef struct i2c_slave_stats_t
+{
+    uint32_t transfers; /**< Transfers finished with Stop, Restart or abort. */
+    /** Bytes taken by the handler from the Rx FIFO or ring buffer. Measured from the FIFO level
+        around each I2C_SLAVE_RECEIVE, so bytes arriving during the call may be missed. Exact
+        with DMA receive. */
+    uint32_t rx_bytes;
+    /** Bytes read by master. Measured from the Tx FIFO level around each I2C_SLAVE_REQUEST /
+        I2C_SLAVE_REFILL, so bytes sent during the call may be missed. Exact with DMA transmit. */
+    uint32_t tx_bytes;
+    uint32_t rx_overflows; /**< Times that master wrote into a full Rx FIFO, and data was dropped (RX_OVER). */
+    uint32_t rx_ring_overflows; /**< Times that DMA receive overwrote data the handler hadn't read. */
+    uint32_t tx_aborts; /**< Transmit aborts (TX_ABRT). */
+    /** Transmit aborts by bit in IC_TX_ABRT_SOURCE, for example
+        `tx_abort_sources[I2C_IC_TX_ABRT_SOURCE_ABRT_SLVFLUSH_TXFIFO_LSB]`. A single abort may count
+        towards several sources. */
+    uint32_t tx_abort_sources[I2C_SLAVE_TX_ABORT_SOURCES];
+    /** RD_REQ interrupts served. Master is clock stretched on each, from RD_REQ until the slave
+        writes the Tx FIFO. This counts the stretches, for how long they last see
+        `i2c_slave_profile_t::rd_req_response`. */
+    uint32_t read_requests;
+    uint32_t tx_prefills; /**< Reads answered from a response staged with `i2c_slave_prefill()`. */
+    uint32_t tx_prefill_misses; /**< Staged responses discarded, because no read followed. */
+} i2c_slave_stats_t;
+
+/**
+ * \brief Get a copy of the slave statistics.
+ *
+ * May be called from thread context while the slave is running, without locking. Each counter is
+ * read atomically, but counters may be one event apart from each other.
+ *
+ * \param i2c Slave I2C instance.
+ * \param stats Receives the statistics.
+ */
+void i2c_slave_get_stats(i2c_inst_t *i2c, i2c_slave_stats_t *stats);
+
+#if I2C_SLAVE_PROFILE
+
+#define I2C_SLAVE_PROFILE_BUCKETS 16
+
+/**
+ * \brief Timing statistics, in CPU cycles.
+ */
+typedef struct i2c_slave_timing_t
+{
+    uint32_t count; /**< Number of samples. */
+    uint32_t min; /**< Shortest sample, or UINT32_MAX if there are none. */
+    uint32_t max; /**< Longest sample. */
+    uint64_t total; /**< Sum of all samples. */
+    /** Bucket 0 counts samples under 1 cycle, and bucket n samples in [2^(n-1), 2^n) cycles. The
+        last bucket also counts all longer samples. */
+    uint32_t histogram[I2C_SLAVE_PROFILE_BUCKETS];
+} i2c_slave_timing_t;
+
+/**
+ * \brief ISR latency profile.
+ *
+ * Cycles are measured with SysTick, which is started free-running on the ISR core unless already
+ * in use. Divide by `clock_get_hz(clk_sys)` for seconds.
+ */
+typedef struct i2c_slave_profile_t
+{
+    i2c_slave_timing_t isr; /**< From ISR entry to exit. */
+    i2c_slave_timing_t handler; /**< Each call to the event handler. */
+    /** From entry of an ISR run serving RD_REQ, until the first byte of the response was written
+        into the Tx FIFO. Interrupt latency before ISR entry isn't included, so the actual clock
+        stretch is longer, by the time from RD_REQ to ISR entry. */
+    i2c_slave_timing_t rd_req_response;
+} i2c_slave_profile_t;
+
+/**
+ * \brief Get a copy of the ISR latency profile.
+ *
+ * Available when I2C_SLAVE_PROFILE is enabled. May be called from thread context while the slave
+ * is running, in which case some statistics may be one sample ahead of others.
+ *
+ * \param i2c Slave I2C instance.
+ * \param profile Receives the profile.
+ */
+void i2c_slave_get_profile(i2c_inst_t *i2c, i2c_slave_profile_t *profile);
+
+/**
+ * \brief Clear the ISR latency profile.
+ *
+ * Available when I2C_SLAVE_PROFILE is enabled.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_reset_profile(i2c_inst_t *i2c);
+
+#endif // I2C_SLAVE_PROFILE
+
+#if I2C_SLAVE_TRACE
+
+/**
+ * \brief Trace record types.
+ */
+typedef enum i2c_slave_trace_event_t
+{
+    I2C_SLAVE_TRACE_IRQ, /**< ISR entry. `level` is the Rx FIFO level, `count` the Tx FIFO level. */
+    I2C_SLAVE_TRACE_RECEIVE, /**< After I2C_SLAVE_RECEIVE. `level` is the data left, `count` the data taken. */
+    I2C_SLAVE_TRACE_REQUEST, /**< After I2C_SLAVE_REQUEST. `level` is the Tx FIFO level, `count` the data written. */
+    I2C_SLAVE_TRACE_REFILL, /**< After I2C_SLAVE_REFILL. `level` is the Tx FIFO level, `count` the data written. */
+    I2C_SLAVE_TRACE_FINISH, /**< Before I2C_SLAVE_FINISH. `level` is 1 for a read, `count` the data left unsent. */
+    I2C_SLAVE_TRACE_ABORT, /**< TX_ABRT. `level` is the flushed byte count, `count` the low bits of IC_TX_ABRT_SOURCE. */
+} i2c_slave_trace_event_t;
+
+/**
+ * \brief Trace record.
+ */
+typedef struct i2c_slave_trace_record_t
+{
+    uint32_t timestamp_us; /**< From `time_us_32()`. */
+    uint16_t intr_stat; /**< IC_INTR_STAT on ISR entry. */
+    uint8_t event; /**< Record type, see `i2c_slave_trace_event_t`. */
+    uint8_t level; /**< FIFO level, depending on the record type. */
+    uint16_t count; /**< Byte count, depending on the record type. */
+} i2c_slave_trace_record_t;
+
+/**
+ * \brief Stop recording, so the trace can be read out.
+ *
+ * Available when I2C_SLAVE_TRACE is enabled. May be called from the handler, to capture the
+ * events leading up to some condition.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_trace_freeze(i2c_inst_t *i2c);
+
+/**
+ * \brief Clear the trace, and start recording again.
+ *
+ * Available when I2C_SLAVE_TRACE is enabled. Recording starts on `i2c_slave_init()`.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_trace_restart(i2c_inst_t *i2c);
+
+/**
+ * \brief Copy the trace, oldest record first.
+ *
+ * Available when I2C_SLAVE_TRACE is enabled. The trace should be frozen, otherwise records may
+ * be overwritten while copying.
+ *
+ * \param i2c Slave I2C instance.
+ * \param records Receives the records.
+ * \param max Maximum number of records to copy.
+ * \param lost Receives the number of older records which have been overwritten. May be NULL.
+ * \return The number of records copied.
+ */
+size_t i2c_slave_trace_read(i2c_inst_t *i2c, i2c_slave_trace_record_t *records, size_t max, uint32_t *lost);
+
+/**
+ * \brief Freeze the trace, and print it to stdio.
+ *
+ * Available when I2C_SLAVE_TRACE is enabled. Call from thread context. Recording stays frozen
+ * until `i2c_slave_trace_restart()`.
+ *
+ * \param i2c Slave I2C instance.
+ */
+void i2c_slave_trace_dump(i2c_inst_t *i2c);
+
+#endif // I2C_SLAVE_TRACE
+
 #ifdef __cplusplus
 }
 #endif
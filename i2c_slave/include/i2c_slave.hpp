@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _I2C_SLAVE_HPP_
+#define _I2C_SLAVE_HPP_
+
+#include <i2c_slave.h>
+#include <type_traits>
+
+/** \file i2c_slave.hpp
+ *
+ * \brief I2C slave with the event handler resolved at compile time (C++17).
+ *
+ * `I2cSlave<Instance, Handler>` instantiates a dedicated ISR for one I2C instance, in RAM. The
+ * handler is a type rather than a function pointer, so its code is inlined into the ISR, and
+ * events it doesn't handle are compiled out. This shortens the interrupt latency compared to
+ * `i2c_slave_init()`, at the cost of the features implemented by the C ISR: statistics,
+ * profiling and DMA.
+ *
+ * Handler is a type with any of these static member functions:
+ *
+ *     static void onReceive(i2c_inst_t *i2c); // I2C_SLAVE_RECEIVE
+ *     static void onRequest(i2c_inst_t *i2c); // I2C_SLAVE_REQUEST
+ *     static void onRefill(i2c_inst_t *i2c);  // I2C_SLAVE_REFILL
+ *     static void onFinish(i2c_inst_t *i2c);  // I2C_SLAVE_FINISH
+ *     static void onStart(i2c_inst_t *i2c);   // a transfer has started, before its first event
+ *
+ * Without onReceive, data written by master is discarded. Without onRequest, reads are answered
+ * with 0xff. Streaming transmit is enabled if and only if there is onRefill, regardless of
+ * `i2c_slave_config_t::tx_streaming`.
+ *
+ * GCC ignores section attributes on template instantiations, so the ISR itself is a plain
+ * function, defined once per instance in a source file with `I2C_SLAVE_DEFINE_IRQ_HANDLER()`:
+ *
+ *     using MySlave = I2cSlave<0, MyHandler>;
+ *     I2C_SLAVE_DEFINE_IRQ_HANDLER(0, MyHandler)
+ *
+ * The handler functions are inlined into it, or else have to be placed with `I2C_SLAVE_HOT()`
+ * themselves.
+ */
+
+extern "C" {
+/** \brief ISR of `I2cSlave<0, Handler>`, see `I2C_SLAVE_DEFINE_IRQ_HANDLER()`. */
+void i2c0_slave_template_irq_handler(void);
+/** \brief ISR of `I2cSlave<1, Handler>`, see `I2C_SLAVE_DEFINE_IRQ_HANDLER()`. */
+void i2c1_slave_template_irq_handler(void);
+}
+
+/**
+ * \brief Define the ISR of `I2cSlave<Instance, Handler>` on the slave hot path.
+ *
+ * Use at namespace scope, in one source file per instance.
+ *
+ * \param Instance I2C instance, 0 or 1.
+ * \param ... Handler type.
+ */
+#define I2C_SLAVE_DEFINE_IRQ_HANDLER(Instance, ...)                                           \
+    extern "C" I2C_SLAVE_HOT("i2c_slave") void i2c##Instance##_slave_template_irq_handler() { \
+        I2cSlave<Instance, __VA_ARGS__>::handleIrq();                                         \
+    }
+
+namespace i2c_slave_detail {
+
+template <typename T, typename = void>
+struct HasOnReceive : std::false_type {};
+template <typename T>
+struct HasOnReceive<T, std::void_t<decltype(T::onReceive((i2c_inst_t *)nullptr))>> : std::true_type {};
+
+template <typename T, typename = void>
+struct HasOnRequest : std::false_type {};
+template <typename T>
+struct HasOnRequest<T, std::void_t<decltype(T::onRequest((i2c_inst_t *)nullptr))>> : std::true_type {};
+
+template <typename T, typename = void>
+struct HasOnRefill : std::false_type {};
+template <typename T>
+struct HasOnRefill<T, std::void_t<decltype(T::onRefill((i2c_inst_t *)nullptr))>> : std::true_type {};
+
+template <typename T, typename = void>
+struct HasOnFinish : std::false_type {};
+template <typename T>
+struct HasOnFinish<T, std::void_t<decltype(T::onFinish((i2c_inst_t *)nullptr))>> : std::true_type {};
+
+template <typename T, typename = void>
+struct HasOnStart : std::false_type {};
+template <typename T>
+struct HasOnStart<T, std::void_t<decltype(T::onStart((i2c_inst_t *)nullptr))>> : std::true_type {};
+
+} // namespace i2c_slave_detail
+
+/**
+ * \brief I2C slave on instance `Instance` (0 or 1), with events handled by `Handler`.
+ *
+ * All members are static, since there is a single I2C block per instance.
+ */
+template <uint Instance, typename Handler>
+class I2cSlave final
+{
+    static_assert(Instance <= 1, "RP2040 has two I2C instances");
+
+public:
+    static constexpr bool HAS_RECEIVE = i2c_slave_detail::HasOnReceive<Handler>::value;
+    static constexpr bool HAS_REQUEST = i2c_slave_detail::HasOnRequest<Handler>::value;
+    static constexpr bool HAS_REFILL = i2c_slave_detail::HasOnRefill<Handler>::value;
+    static constexpr bool HAS_FINISH = i2c_slave_detail::HasOnFinish<Handler>::value;
+    static constexpr bool HAS_START = i2c_slave_detail::HasOnStart<Handler>::value;
+
+    I2cSlave() = delete;
+
+    static i2c_inst_t *i2c() {
+        return Instance == 0 ? i2c0 : i2c1;
+    }
+
+    /**
+     * \brief Configure the I2C instance for slave mode, with default settings.
+     *
+     * \param address 7-bit slave address.
+     */
+    static void init(uint8_t address) {
+        i2c_slave_config_t config = i2c_slave_get_default_config();
+        config.tx_threshold = HAS_REFILL ? 8 : 0;
+        init(address, config);
+    }
+
+    /**
+     * \brief Configure the I2C instance for slave mode.
+     *
+     * \param address 7-bit slave address.
+     * \param config Slave configuration. DMA and PEC are not supported, and `tx_streaming` is
+     *               ignored.
+     */
+    static void init(uint8_t address, const i2c_slave_config_t &config) {
+        transferInProgress_ = false;
+        transferIsRead_ = false;
+        streamingActive_ = false;
+        txUnsent_ = 0;
+        i2c_slave_config_t slave_config = config;
+        slave_config.tx_streaming = HAS_REFILL;
+        slave_config.pec = false;
+        i2c_slave_init_with_irq_handler(i2c(), address, irqHandler(), &slave_config);
+    }
+
+    /**
+     * \brief Restore the I2C instance to master mode.
+     */
+    static void deinit() {
+        i2c_slave_deinit(i2c());
+    }
+
+    /**
+     * \brief Get the number of bytes left unsent in the Tx FIFO by the last transfer, as for
+     * `i2c_slave_get_tx_unsent()`. Valid from onFinish.
+     */
+    static uint getTxUnsent() {
+        return txUnsent_;
+    }
+
+    /**
+     * \brief Serve the I2C interrupt. Inlined into the ISR defined by
+     * `I2C_SLAVE_DEFINE_IRQ_HANDLER()`, not meant to be called otherwise.
+     *
+     * Same sequence as the C ISR in i2c_slave.c, minus statistics, profiling and DMA.
+     */
+    static __force_inline void handleIrq();
+
+private:
+    static irq_handler_t irqHandler() {
+        // only the ISR of this instance needs to be defined
+        if constexpr (Instance == 0) {
+            return &i2c0_slave_template_irq_handler;
+        } else {
+            return &i2c1_slave_template_irq_handler;
+        }
+    }
+
+    static __force_inline i2c_hw_t *hw() {
+        return i2c_get_hw(i2c());
+    }
+
+    static __force_inline void beginTransfer() {
+        if (!transferInProgress_) {
+            transferInProgress_ = true;
+            if constexpr (HAS_START) {
+                Handler::onStart(i2c());
+            }
+        }
+    }
+
+    static __force_inline void receive() {
+        beginTransfer();
+        if constexpr (HAS_RECEIVE) {
+            Handler::onReceive(i2c());
+        } else {
+            while (hw()->rxflr != 0) {
+                (void)hw()->data_cmd;
+            }
+        }
+    }
+
+    static __force_inline void request() {
+        if constexpr (HAS_REQUEST) {
+            Handler::onRequest(i2c());
+        } else {
+            hw()->data_cmd = 0xff;
+        }
+    }
+
+    static __force_inline void startStreaming() {
+        hw()->clr_rx_done;
+        hw_set_bits(&hw()->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS | I2C_IC_INTR_MASK_M_RX_DONE_BITS);
+        streamingActive_ = true;
+    }
+
+    static __force_inline void stopStreaming() {
+        hw_clear_bits(&hw()->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS | I2C_IC_INTR_MASK_M_RX_DONE_BITS);
+        streamingActive_ = false;
+    }
+
+    static __force_inline void finishTransfer(uint txFlushed) {
+        // with an Rx threshold above 1, the tail of the transfer may still be waiting in the Rx FIFO
+        while (hw()->rxflr != 0) {
+            receive();
+        }
+        if constexpr (HAS_REFILL) {
+            if (streamingActive_) {
+                stopStreaming();
+            }
+        }
+        if (transferInProgress_) {
+            txUnsent_ = transferIsRead_ ? hw()->txflr + txFlushed : 0;
+            if constexpr (HAS_FINISH) {
+                Handler::onFinish(i2c());
+            }
+            transferInProgress_ = false;
+            transferIsRead_ = false;
+        }
+    }
+
+    static inline bool transferInProgress_ = false;
+    static inline bool transferIsRead_ = false;
+    static inline bool streamingActive_ = false;
+    static inline uint txUnsent_ = 0;
+};
+
+template <uint Instance, typename Handler>
+__force_inline void I2cSlave<Instance, Handler>::handleIrq() {
+    i2c_hw_t *hw = I2cSlave::hw();
+
+    uint32_t intr_stat = hw->intr_stat;
+    if (intr_stat == 0) {
+        return;
+    }
+    if (intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // abort source is cleared together with the interrupt
+        uint32_t abort_source = hw->tx_abrt_source;
+        hw->clr_tx_abrt;
+        finishTransfer((abort_source & I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_BITS) >> I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_LSB);
+    }
+    if (intr_stat & I2C_IC_INTR_STAT_R_RX_OVER_BITS) {
+        hw->clr_rx_over;
+    }
+    if (intr_stat & I2C_IC_INTR_STAT_R_START_DET_BITS) {
+        hw->clr_start_det;
+        finishTransfer(0);
+    }
+    if (intr_stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        hw->clr_stop_det;
+        finishTransfer(0);
+    }
+    if constexpr (HAS_REFILL) {
+        if (intr_stat & I2C_IC_INTR_STAT_R_RX_DONE_BITS) {
+            // master has NACKed the last byte of a read
+            hw->clr_rx_done;
+            if (streamingActive_) {
+                stopStreaming();
+            }
+        }
+    }
+    // the Rx FIFO may have been drained already, when finishing the previous transfer
+    if ((intr_stat & I2C_IC_INTR_STAT_R_RX_FULL_BITS) && hw->rxflr != 0) {
+        receive();
+    }
+    if (intr_stat & I2C_IC_INTR_STAT_R_RD_REQ_BITS) {
+        // master is waiting on an empty Tx FIFO, with the bus stretched
+        hw->clr_rd_req;
+        beginTransfer();
+        transferIsRead_ = true;
+        request();
+        if constexpr (HAS_REFILL) {
+            if (!streamingActive_ && hw->txflr != 0) {
+                startStreaming();
+            }
+        }
+    }
+    if constexpr (HAS_REFILL) {
+        // TX_EMPTY may have been masked while handling the events above
+        if ((intr_stat & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS) && streamingActive_) {
+            uint level = hw->txflr;
+            Handler::onRefill(i2c());
+            if (hw->txflr <= level) {
+                // nothing more to send for now, wait for the next I2C_SLAVE_REQUEST
+                stopStreaming();
+            }
+        }
+    }
+}
+
+#endif // _I2C_SLAVE_HPP_
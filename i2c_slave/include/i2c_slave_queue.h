@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _I2C_SLAVE_QUEUE_H_
+#define _I2C_SLAVE_QUEUE_H_
+
+#include <i2c_slave.h>
+#include <hardware/sync.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file i2c_slave_queue.h
+ *
+ * \brief Queue of completed I2C slave transactions, for processing outside the ISR.
+ *
+ * The slave handler (producer) records each transaction into the queue, and the main loop or
+ * the other core (consumer) takes them out. This is a single-producer / single-consumer queue,
+ * so neither side needs a lock.
+ *
+ * Transactions arriving while the queue is full are dropped. For lossless receive, initialize the
+ * slave with `rx_hold_bus`, and have the consumer call `i2c_slave_pause_rx()` once
+ * `i2c_slave_queue_count()` gets close to `i2c_slave_queue_capacity()`. Master is then held until
+ * the consumer catches up and calls `i2c_slave_resume_rx()`.
+ */
+
+#ifndef I2C_SLAVE_QUEUE_MAX_DATA
+#define I2C_SLAVE_QUEUE_MAX_DATA 32
+#endif
+
+/**
+ * \brief A completed transaction.
+ */
+typedef struct i2c_slave_transaction_t
+{
+    uint32_t timestamp_us; /**< Time when the transaction started, from `time_us_32()`. */
+    uint8_t i2c_index; /**< I2C instance index. */
+    uint8_t address; /**< 7-bit slave address. */
+    bool is_read; /**< Master read from slave. Reads have no payload, since the response is
+                       written from the ISR. */
+    bool truncated; /**< The payload didn't fit, and excess data was discarded. */
+    uint16_t length; /**< Payload size. */
+    uint8_t data[I2C_SLAVE_QUEUE_MAX_DATA]; /**< Payload written by master. */
+} i2c_slave_transaction_t;
+
+/**
+ * \brief Transaction queue. Treat as opaque.
+ */
+typedef struct i2c_slave_queue_t
+{
+    i2c_slave_transaction_t *slots;
+    uint32_t mask; // number of slots - 1
+    volatile uint32_t head; // written by producer
+    volatile uint32_t tail; // written by consumer
+    volatile uint32_t dropped; // written by producer
+    bool pending; // a transaction is being recorded into slots[head]
+    bool discarding; // queue was full when the current transaction started
+    bool doorbell;
+    uint32_t doorbell_value;
+} i2c_slave_queue_t;
+
+/**
+ * \brief Initialize a transaction queue.
+ *
+ * \param queue Queue state.
+ * \param slots Transaction storage.
+ * \param num_slots Number of transactions, must be a power of two.
+ */
+void i2c_slave_queue_init(i2c_slave_queue_t *queue, i2c_slave_transaction_t *slots, uint num_slots);
+
+/**
+ * \brief Ring a doorbell on the other core after each transaction.
+ *
+ * Pushes `value` into the inter-core FIFO (as read by `multicore_fifo_pop_blocking()`), so
+ * the consumer can sleep until there is work. The doorbell is skipped if the FIFO is full,
+ * which means the consumer has pending wakeups anyway.
+ *
+ * \param queue Queue state.
+ * \param enabled Whether to ring the doorbell.
+ * \param value Value pushed into the inter-core FIFO.
+ */
+void i2c_slave_queue_set_doorbell(i2c_slave_queue_t *queue, bool enabled, uint32_t value);
+
+/**
+ * \brief Record slave events into the queue. Producer side.
+ *
+ * Call from the slave handler for every event. On I2C_SLAVE_RECEIVE it drains the Rx FIFO
+ * into the current transaction, and on I2C_SLAVE_FINISH it publishes the transaction. Requests
+ * are only recorded - the handler must still respond to I2C_SLAVE_REQUEST.
+ *
+ * If the queue is full, new transactions are dropped and counted by `i2c_slave_queue_dropped()`.
+ *
+ * \param queue Queue state.
+ * \param i2c Slave I2C instance.
+ * \param event Event type.
+ */
+void i2c_slave_queue_handle_event(i2c_slave_queue_t *queue, i2c_inst_t *i2c, i2c_slave_event_t event);
+
+/**
+ * \brief Get the oldest transaction in the queue, without removing it. Consumer side.
+ *
+ * \param queue Queue state.
+ * \return The transaction, or NULL if the queue is empty. Stays valid until
+ *         `i2c_slave_queue_pop()`.
+ */
+static inline const i2c_slave_transaction_t *i2c_slave_queue_peek(i2c_slave_queue_t *queue) {
+    uint32_t tail = queue->tail;
+    if (queue->head == tail) {
+        return NULL;
+    }
+    __dmb(); // read the slot after seeing the head update
+    return &queue->slots[tail & queue->mask];
+}
+
+/**
+ * \brief Remove the oldest transaction from the queue. Consumer side.
+ *
+ * \param queue Queue state, must not be empty.
+ */
+static inline void i2c_slave_queue_pop(i2c_slave_queue_t *queue) {
+    assert(queue->head != queue->tail);
+
+    __dmb(); // finish with the slot before handing it back
+    queue->tail = queue->tail + 1;
+}
+
+/**
+ * \brief Get the number of transactions in the queue.
+ *
+ * \param queue Queue state.
+ */
+static inline uint i2c_slave_queue_count(const i2c_slave_queue_t *queue) {
+    return queue->head - queue->tail;
+}
+
+/**
+ * \brief Get the number of transaction slots.
+ *
+ * \param queue Queue state.
+ */
+static inline uint i2c_slave_queue_capacity(const i2c_slave_queue_t *queue) {
+    return queue->mask + 1;
+}
+
+/**
+ * \brief Get the number of transactions dropped because the queue was full.
+ *
+ * \param queue Queue state.
+ */
+static inline uint32_t i2c_slave_queue_dropped(const i2c_slave_queue_t *queue) {
+    return queue->dropped;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _I2C_SLAVE_QUEUE_H_
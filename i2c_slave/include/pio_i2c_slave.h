@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _PIO_I2C_SLAVE_H_
+#define _PIO_I2C_SLAVE_H_
+
+#include <i2c_slave.h>
+#include <hardware/pio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file pio_i2c_slave.h
+ *
+ * \brief I2C slave running on a PIO state machine.
+ *
+ * An alternative to the hardware I2C blocks, for when two slave ports aren't enough. Each port
+ * takes two state machines, one moving bytes and one detecting Start / Stop, so there can be up
+ * to four. The programs fill the instruction memory of the PIO instance, which can't be shared
+ * with other programs. Unlike DW_apb_i2c, a port may answer several addresses, and the handler
+ * can NACK a byte from master, for flow control.
+ *
+ * The handler sees the same events as with `i2c_slave_init()`, but one byte at a time: each
+ * I2C_SLAVE_RECEIVE carries one byte, and each I2C_SLAVE_REQUEST asks for one byte. SCL is
+ * stretched until the handler returns.
+ *
+ * Addresses are checked in PIO first, against the upper bits which all of the port's addresses
+ * share (all 7 for a single address), so the bus isn't stretched while the ISR looks at
+ * transfers for other devices. Those are NACKed without involving the CPU. Addresses sharing the
+ * bits but not in the list, such as 0x51 for a port answering 0x50 and 0x53, are NACKed by the
+ * ISR, with SCL stretched meanwhile. Keep a port's addresses close together to avoid this. If they
+ * share no bits, or only zeros (0x08 and 0x10), every address goes through the ISR.
+ *
+ * Start and Stop are told apart in PIO, at the SDA edge. The one timing constraint left is on the
+ * ISR: after a Start, it must restart the byte state machine before the first address bit, which
+ * leaves tHD;STA + tLOW (about 9 us at 100 kb/s, 1.9 us at 400 kb/s). The port is rated for
+ * 100 kb/s, the rate `example_pio_slave` runs at. Faster buses work only if interrupt latency,
+ * including other ISRs on the same core, stays well within that window.
+ */
+
+/**
+ * \brief Maximum number of addresses per port.
+ */
+#define PIO_I2C_SLAVE_MAX_ADDRESSES 8
+
+typedef struct pio_i2c_slave_t pio_i2c_slave_t;
+
+/**
+ * \brief PIO I2C slave event handler.
+ *
+ * Runs from the PIO ISR, with the same constraints as `i2c_slave_handler_t`.
+ *
+ * \param slave Slave port.
+ * \param event Event type.
+ */
+typedef void (*pio_i2c_slave_handler_t)(pio_i2c_slave_t *slave, i2c_slave_event_t event);
+
+/**
+ * \brief PIO I2C slave configuration.
+ */
+typedef struct pio_i2c_slave_config_t
+{
+    PIO pio; /**< PIO instance, a free state machine is claimed from it. */
+    uint sda_pin; /**< SDA pin. SCL must be on the next pin. */
+    uint8_t addresses[PIO_I2C_SLAVE_MAX_ADDRESSES]; /**< 7-bit addresses to answer. */
+    uint num_addresses; /**< Number of addresses. */
+    void *user; /**< Context pointer, see `pio_i2c_slave_get_user()`. */
+} pio_i2c_slave_config_t;
+
+/**
+ * \brief PIO I2C slave state. Treat as opaque.
+ */
+struct pio_i2c_slave_t
+{
+    pio_i2c_slave_config_t config;
+    pio_i2c_slave_handler_t handler;
+    uint sm;
+    uint condition_sm; // detects Start / Stop
+    uint offset; // program offset in PIO instruction memory
+    uint8_t state;
+    uint8_t address; // address of the current transfer
+    uint8_t address_bits; // upper address bits compared in PIO, 0 if none
+    bool transfer_in_progress;
+    bool rx_pending;
+    uint8_t rx_data;
+    bool tx_pending;
+    uint8_t tx_data;
+    bool nack;
+};
+
+/**
+ * \brief Get the default configuration for a PIO I2C slave.
+ *
+ * \param pio PIO instance.
+ * \param sda_pin SDA pin, SCL must be on `sda_pin + 1`.
+ * \param address 7-bit slave address. More can be added to `addresses`.
+ */
+pio_i2c_slave_config_t pio_i2c_slave_get_default_config(PIO pio, uint sda_pin, uint8_t address);
+
+/**
+ * \brief Start a PIO I2C slave port.
+ *
+ * Loads the programs into the PIO instance unless they're there already, claims two state
+ * machines, and sets up the pins. The interrupts are handled on the calling core. Use `pio_i2c_slave_deinit()` to stop.
+ *
+ * \param slave Slave state. Must stay valid until `pio_i2c_slave_deinit()`.
+ * \param config Slave configuration.
+ * \param handler Called on events from I2C master.
+ */
+void pio_i2c_slave_init(pio_i2c_slave_t *slave, const pio_i2c_slave_config_t *config, pio_i2c_slave_handler_t handler);
+
+/**
+ * \brief Stop a PIO I2C slave port, and release its state machines.
+ *
+ * \param slave Slave state.
+ */
+void pio_i2c_slave_deinit(pio_i2c_slave_t *slave);
+
+/**
+ * \brief Get the byte written by master. Call from I2C_SLAVE_RECEIVE.
+ *
+ * \param slave Slave port.
+ */
+static inline uint8_t pio_i2c_slave_read_byte(pio_i2c_slave_t *slave) {
+    assert(slave->rx_pending);
+
+    slave->rx_pending = false;
+    return slave->rx_data;
+}
+
+/**
+ * \brief Set the byte sent to master. Call from I2C_SLAVE_REQUEST, otherwise 0xFF is sent.
+ *
+ * \param slave Slave port.
+ * \param value Byte value.
+ */
+static inline void pio_i2c_slave_write_byte(pio_i2c_slave_t *slave, uint8_t value) {
+    assert(!slave->tx_pending);
+
+    slave->tx_data = value;
+    slave->tx_pending = true;
+}
+
+/**
+ * \brief NACK the byte from master. Call from I2C_SLAVE_RECEIVE.
+ *
+ * Master should stop writing, and the rest of the transfer is ignored.
+ *
+ * \param slave Slave port.
+ */
+static inline void pio_i2c_slave_nack(pio_i2c_slave_t *slave) {
+    slave->nack = true;
+}
+
+/**
+ * \brief Get the address master is talking to, out of those configured.
+ *
+ * \param slave Slave port.
+ */
+static inline uint8_t pio_i2c_slave_get_address(const pio_i2c_slave_t *slave) {
+    return slave->address;
+}
+
+/**
+ * \brief Get the context pointer from `pio_i2c_slave_config_t`.
+ *
+ * \param slave Slave port.
+ */
+static inline void *pio_i2c_slave_get_user(const pio_i2c_slave_t *slave) {
+    return slave->config.user;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PIO_I2C_SLAVE_H_
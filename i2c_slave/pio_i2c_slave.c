@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <pio_i2c_slave.h>
+#include <hardware/clocks.h>
+#include <hardware/gpio.h>
+#include <hardware/irq.h>
+#include "pio_i2c_slave.pio.h"
+
+// state machine clock, so the 8 cycle delay in the program covers the 250 ns data setup time
+#define SM_CLOCK_HZ 32000000u
+
+enum
+{
+    STATE_IDLE, // waiting for Start
+    STATE_ADDRESS, // receiving the address byte
+    STATE_WRITE, // master is writing
+    STATE_READ, // master is reading
+};
+
+static I2C_SLAVE_HOT_DATA("pio_i2c_slave") pio_i2c_slave_t *pio_i2c_slaves[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+static uint program_users[NUM_PIOS];
+static uint program_offsets[NUM_PIOS];
+static uint condition_offsets[NUM_PIOS];
+
+// Answer to the byte state machine, see pio_i2c_slave.pio: routine addresses, each followed by
+// what the routine takes from the answer, read MSB first.
+typedef struct
+{
+    uint32_t word;
+    uint len;
+} answer_t;
+
+static inline void append_bits(answer_t *answer, uint32_t bits, uint count) {
+    answer->len += count;
+    answer->word |= bits << (32 - answer->len);
+}
+
+static inline void append_routine(answer_t *answer, const pio_i2c_slave_t *slave, uint routine) {
+    append_bits(answer, slave->offset + routine, 5);
+}
+
+// clock out count bits, a 1 bit pulls SDA low
+static inline void append_send(answer_t *answer, const pio_i2c_slave_t *slave, uint32_t bits, uint count) {
+    append_routine(answer, slave, pio_i2c_slave_offset_send);
+    append_bits(answer, count - 1, 3);
+    append_bits(answer, bits, count);
+}
+
+static inline void append_ack(answer_t *answer, const pio_i2c_slave_t *slave) {
+    append_send(answer, slave, 1, 1);
+}
+
+// send a byte, then read master's acknowledge
+static inline void append_send_byte(answer_t *answer, const pio_i2c_slave_t *slave, uint8_t value) {
+    append_send(answer, slave, (uint8_t)~value, 8);
+    append_routine(answer, slave, pio_i2c_slave_offset_ack_in);
+}
+
+static inline void put(pio_i2c_slave_t *slave, const answer_t *answer) {
+    // one word per byte, sent while SCL is stretched, so this doesn't block
+    pio_sm_put(slave->config.pio, slave->sm, answer->word);
+}
+
+// NACK, or stop sending after master's NACK, by leaving SDA released until the next Start
+static inline void put_idle(pio_i2c_slave_t *slave) {
+    answer_t answer = {0, 0};
+    append_routine(&answer, slave, pio_i2c_slave_offset_idle);
+    put(slave, &answer);
+}
+
+static inline uint8_t request_byte(pio_i2c_slave_t *slave) {
+    slave->tx_pending = false;
+    slave->handler(slave, I2C_SLAVE_REQUEST);
+    uint8_t value = slave->tx_pending ? slave->tx_data : 0xff;
+    slave->tx_pending = false;
+    return value;
+}
+
+static inline bool matches_address(const pio_i2c_slave_t *slave, uint8_t address) {
+    for (uint i = 0; i < slave->config.num_addresses; i++) {
+        if (slave->config.addresses[i] == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// number of upper address bits shared by all addresses of the port, for comparing in PIO
+static uint shared_address_bits(const pio_i2c_slave_config_t *config) {
+    uint diff = 0;
+    for (uint i = 1; i < config->num_addresses; i++) {
+        diff |= config->addresses[i] ^ config->addresses[0];
+    }
+    uint bits = 7;
+    for (; diff != 0; diff >>= 1) {
+        bits--;
+    }
+    // PIO tells the address apart from data bytes by the shared bits not being 0
+    return bits != 0 && (config->addresses[0] >> (7 - bits)) != 0 ? bits : 0;
+}
+
+static void I2C_SLAVE_HOT_FUNC(jump)(pio_i2c_slave_t *slave, uint routine) {
+    // After a Start, this must be done before the first address bit, so keep to the inline SDK
+    // functions here rather than calling into flash.
+    PIO pio = slave->config.pio;
+    pio_sm_set_enabled(pio, slave->sm, false);
+    pio_sm_clear_fifos(pio, slave->sm);
+    pio_sm_restart(pio, slave->sm);
+    // release both lines, SDA with set and SCL with side-set
+    pio_sm_exec(pio, slave->sm, pio_encode_set(pio_pindirs, 0) | pio_encode_sideset_opt(1, 0));
+    if (routine == pio_i2c_slave_offset_address) {
+        // bit counts for comparing the address, Y holds the bits themselves
+        uint bits = slave->address_bits;
+        pio_sm_exec(pio, slave->sm, pio_encode_set(pio_x, 7 - bits));
+        pio_sm_exec(pio, slave->sm, pio_encode_mov(pio_osr, pio_x));
+        pio_sm_exec(pio, slave->sm, pio_encode_set(pio_x, bits - 1));
+    }
+    pio_sm_exec(pio, slave->sm, pio_encode_jmp(slave->offset + routine));
+    pio_sm_set_enabled(pio, slave->sm, true);
+}
+
+static void I2C_SLAVE_HOT_FUNC(finish_transfer)(pio_i2c_slave_t *slave) {
+    if (slave->transfer_in_progress) {
+        slave->handler(slave, I2C_SLAVE_FINISH);
+        slave->transfer_in_progress = false;
+    }
+}
+
+static void I2C_SLAVE_HOT_FUNC(service_byte)(pio_i2c_slave_t *slave, uint32_t word) {
+    switch (slave->state) {
+    case STATE_ADDRESS: {
+        // only addresses sharing the bits compared in PIO get here
+        uint8_t address = (uint8_t)word >> 1;
+        if (!matches_address(slave, address)) {
+            put_idle(slave);
+            slave->state = STATE_IDLE;
+            break;
+        }
+        slave->address = address;
+        slave->transfer_in_progress = true;
+        answer_t answer = {0, 0};
+        append_ack(&answer, slave);
+        if (word & 1) {
+            append_send_byte(&answer, slave, request_byte(slave));
+            slave->state = STATE_READ;
+        } else {
+            append_routine(&answer, slave, pio_i2c_slave_offset_rx_byte);
+            slave->state = STATE_WRITE;
+        }
+        put(slave, &answer);
+        break;
+    }
+    case STATE_WRITE:
+        slave->rx_data = (uint8_t)word;
+        slave->rx_pending = true;
+        slave->nack = false;
+        slave->handler(slave, I2C_SLAVE_RECEIVE);
+        slave->rx_pending = false;
+        if (slave->nack) {
+            put_idle(slave);
+            slave->state = STATE_IDLE;
+        } else {
+            answer_t answer = {0, 0};
+            append_ack(&answer, slave);
+            append_routine(&answer, slave, pio_i2c_slave_offset_rx_byte);
+            put(slave, &answer);
+        }
+        break;
+    case STATE_READ:
+        if (word & 1) {
+            // master has NACKed the last byte, and is about to send Stop / Restart
+            put_idle(slave);
+            slave->state = STATE_IDLE;
+        } else {
+            answer_t answer = {0, 0};
+            append_send_byte(&answer, slave, request_byte(slave));
+            put(slave, &answer);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void I2C_SLAVE_HOT_FUNC(service_condition)(pio_i2c_slave_t *slave, bool stop) {
+    finish_transfer(slave);
+    if (stop) {
+        jump(slave, pio_i2c_slave_offset_idle);
+        slave->state = STATE_IDLE;
+    } else {
+        // Start or Restart
+        jump(slave, slave->address_bits != 0 ? pio_i2c_slave_offset_address : pio_i2c_slave_offset_rx_byte);
+        slave->state = STATE_ADDRESS;
+    }
+}
+
+static inline void service_pio(uint pio_index) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        pio_i2c_slave_t *slave = pio_i2c_slaves[pio_index][sm];
+        if (slave == NULL) {
+            continue; // free, or the condition state machine of a port
+        }
+        PIO pio = slave->config.pio;
+        // handle bytes which were waiting in the Rx FIFO, before moving on to the next transfer
+        while (!pio_sm_is_rx_fifo_empty(pio, slave->sm)) {
+            service_byte(slave, pio_sm_get(pio, slave->sm));
+        }
+        while (!pio_sm_is_rx_fifo_empty(pio, slave->condition_sm)) {
+            service_condition(slave, pio_sm_get(pio, slave->condition_sm) != 0);
+        }
+    }
+}
+
+static void I2C_SLAVE_HOT_FUNC(pio0_irq_handler)() {
+    service_pio(0);
+}
+
+static void I2C_SLAVE_HOT_FUNC(pio1_irq_handler)() {
+    service_pio(1);
+}
+
+pio_i2c_slave_config_t pio_i2c_slave_get_default_config(PIO pio, uint sda_pin, uint8_t address) {
+    pio_i2c_slave_config_t config = {
+        .pio = pio,
+        .sda_pin = sda_pin,
+        .addresses = {address},
+        .num_addresses = 1,
+        .user = NULL,
+    };
+    return config;
+}
+
+void pio_i2c_slave_init(pio_i2c_slave_t *slave, const pio_i2c_slave_config_t *config, pio_i2c_slave_handler_t handler) {
+    assert(slave != NULL);
+    assert(handler != NULL);
+    assert(config->sda_pin + 1 < NUM_BANK0_GPIOS);
+    assert(0 < config->num_addresses && config->num_addresses <= PIO_I2C_SLAVE_MAX_ADDRESSES);
+
+    PIO pio = config->pio;
+    uint pio_index = pio_get_index(pio);
+    uint sda_pin = config->sda_pin;
+    uint scl_pin = sda_pin + 1;
+
+    slave->config = *config;
+    slave->handler = handler;
+    slave->sm = (uint)pio_claim_unused_sm(pio, true);
+    slave->condition_sm = (uint)pio_claim_unused_sm(pio, true);
+    slave->state = STATE_IDLE;
+    slave->address = 0;
+    slave->transfer_in_progress = false;
+    slave->rx_pending = false;
+    slave->tx_pending = false;
+    slave->nack = false;
+    slave->address_bits = (uint8_t)shared_address_bits(config);
+
+    if (program_users[pio_index]++ == 0) {
+        program_offsets[pio_index] = pio_add_program(pio, &pio_i2c_slave_program);
+        condition_offsets[pio_index] = pio_add_program(pio, &pio_i2c_slave_condition_program);
+        irq_add_shared_handler(PIO0_IRQ_0 + 2 * pio_index, pio_index == 0 ? pio0_irq_handler : pio1_irq_handler,
+            PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(PIO0_IRQ_0 + 2 * pio_index, true);
+    }
+    slave->offset = program_offsets[pio_index];
+
+    pio_gpio_init(pio, sda_pin);
+    pio_gpio_init(pio, scl_pin);
+    gpio_pull_up(sda_pin);
+    gpio_pull_up(scl_pin);
+
+    pio_sm_config c = pio_i2c_slave_program_get_default_config(slave->offset);
+    sm_config_set_in_pins(&c, sda_pin);
+    sm_config_set_out_pins(&c, sda_pin, 1);
+    sm_config_set_set_pins(&c, sda_pin, 1);
+    sm_config_set_sideset_pins(&c, scl_pin);
+    sm_config_set_in_shift(&c, false, true, 8); // MSB first, autopush each byte
+    sm_config_set_out_shift(&c, false, false, 32);
+    float div = (float)clock_get_hz(clk_sys) / SM_CLOCK_HZ;
+    sm_config_set_clkdiv(&c, div < 1.0f ? 1.0f : div);
+
+    // lines are only ever pulled low, by changing pin direction
+    uint32_t pin_mask = 3u << sda_pin;
+    pio_sm_set_pins_with_mask(pio, slave->sm, 0, pin_mask);
+    pio_sm_set_pindirs_with_mask(pio, slave->sm, 0, pin_mask);
+    pio_sm_init(pio, slave->sm, slave->offset + pio_i2c_slave_offset_idle, &c);
+    if (slave->address_bits != 0) {
+        // Y holds the address bits compared in PIO, see jump()
+        pio_sm_put(pio, slave->sm, config->addresses[0] >> (7 - slave->address_bits));
+        pio_sm_exec(pio, slave->sm, pio_encode_pull(false, true));
+        pio_sm_exec(pio, slave->sm, pio_encode_mov(pio_y, pio_osr));
+    }
+
+    // the condition state machine runs at full speed, to catch SDA edges right away
+    uint condition_offset = condition_offsets[pio_index];
+    c = pio_i2c_slave_condition_program_get_default_config(condition_offset);
+    sm_config_set_in_pins(&c, sda_pin);
+    sm_config_set_jmp_pin(&c, scl_pin);
+    sm_config_set_in_shift(&c, false, true, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv(&c, 1.0f);
+    pio_sm_init(pio, slave->condition_sm, condition_offset + pio_i2c_slave_condition_offset_entry, &c);
+    pio_sm_exec(pio, slave->condition_sm, pio_encode_mov_not(pio_y, pio_null)); // reported for Stop
+
+    pio_i2c_slaves[pio_index][slave->sm] = slave;
+    pio_set_irq0_source_enabled(pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + slave->sm), true);
+    pio_set_irq0_source_enabled(pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + slave->condition_sm), true);
+    pio_set_sm_mask_enabled(pio, (1u << slave->sm) | (1u << slave->condition_sm), true);
+}
+
+void pio_i2c_slave_deinit(pio_i2c_slave_t *slave) {
+    PIO pio = slave->config.pio;
+    uint pio_index = pio_get_index(pio);
+    assert(pio_i2c_slaves[pio_index][slave->sm] == slave); // should be called after pio_i2c_slave_init()
+
+    pio_set_sm_mask_enabled(pio, (1u << slave->sm) | (1u << slave->condition_sm), false);
+    pio_set_irq0_source_enabled(pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + slave->sm), false);
+    pio_set_irq0_source_enabled(pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + slave->condition_sm), false);
+    pio_sm_set_pindirs_with_mask(pio, slave->sm, 0, 3u << slave->config.sda_pin);
+    pio_i2c_slaves[pio_index][slave->sm] = NULL;
+    pio_sm_unclaim(pio, slave->sm);
+    pio_sm_unclaim(pio, slave->condition_sm);
+
+    if (--program_users[pio_index] == 0) {
+        irq_set_enabled(PIO0_IRQ_0 + 2 * pio_index, false);
+        irq_remove_handler(PIO0_IRQ_0 + 2 * pio_index, pio_index == 0 ? pio0_irq_handler : pio1_irq_handler);
+        pio_remove_program(pio, &pio_i2c_slave_program, program_offsets[pio_index]);
+        pio_remove_program(pio, &pio_i2c_slave_condition_program, condition_offsets[pio_index]);
+    }
+}
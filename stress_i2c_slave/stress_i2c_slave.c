@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <i2c_regmap.h>
+#include <i2c_slave.h>
+#include <hardware/timer.h>
+#include <pico/stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Core which runs the slave ISR. With core 1, master and slave run in parallel, each on its own
+// core and I2C block.
+#ifndef STRESS_SLAVE_CORE
+#define STRESS_SLAVE_CORE 1
+#endif
+
+#if STRESS_SLAVE_CORE
+#include <pico/multicore.h>
+#endif
+
+// seconds spent on each slave configuration
+#ifndef STRESS_PHASE_S
+#define STRESS_PHASE_S 60
+#endif
+
+// seconds between report lines
+#ifndef STRESS_REPORT_S
+#define STRESS_REPORT_S 5
+#endif
+
+// total run time in seconds, or 0 to run until reset
+#ifndef STRESS_DURATION_S
+#define STRESS_DURATION_S 0
+#endif
+
+// seed for the transaction mix, or 0 to pick one at startup
+#ifndef STRESS_SEED
+#define STRESS_SEED 0
+#endif
+
+static const uint I2C_SLAVE_ADDRESS = 0x17;
+static const uint I2C_ABSENT_ADDRESS = 0x18; // nobody answers here
+static const uint TIMEOUT_US = 50000; // far longer than any transfer at 100 kHz
+
+// Same wiring as the examples: GP4 to GP6 (SDA), and GP5 to GP7 (SCL). For 1 MHz, add external
+// pull-up resistors (around 1 kOhm), the internal ones are too weak.
+static const uint I2C_SLAVE_SDA_PIN = PICO_DEFAULT_I2C_SDA_PIN; // 4
+static const uint I2C_SLAVE_SCL_PIN = PICO_DEFAULT_I2C_SCL_PIN; // 5
+static const uint I2C_MASTER_SDA_PIN = 6;
+static const uint I2C_MASTER_SCL_PIN = 7;
+
+#define MEM_SIZE 256
+#define MAX_TRANSFER 64
+#define READ_ONLY_START 240 // the last 16 registers ignore writes
+
+// The slave serves a register map, and master keeps a reference model of it. Every read is
+// checked against the model, so lost, duplicated or misplaced bytes show up as mismatches.
+static uint8_t mem[MEM_SIZE];
+static i2c_regmap_t regmap;
+
+static const i2c_regmap_range_t ranges[] = {
+    {.start = READ_ONLY_START, .size = MEM_SIZE - READ_ONLY_START, .flags = I2C_REGMAP_READ_ONLY},
+};
+
+typedef struct stress_phase_t
+{
+    uint baudrate;
+    bool fast_mode_plus; // i2c_slave_get_fast_mode_plus_config(), batching the FIFOs
+    bool prefill;
+} stress_phase_t;
+
+static const stress_phase_t PHASES[] = {
+    {100000, false, false},
+    {400000, false, false},
+    {400000, false, true},
+    {1000000, true, false},
+    {1000000, true, true},
+};
+
+static struct
+{
+    uint8_t mem[MEM_SIZE];
+    uint8_t address; // slave register address
+    bool address_known; // false after an error, until master sets the address again
+} model;
+
+typedef struct stress_counters_t
+{
+    uint32_t transactions;
+    uint64_t bytes; // payload only, without register addresses
+    uint32_t mismatches; // reads which didn't match the model
+    uint32_t failures; // transfers which failed or came up short
+    uint32_t timeouts;
+    uint32_t nacks; // transfers to the absent address which were wrongly ACKed
+} stress_counters_t;
+
+static stress_counters_t counters;
+
+//
+// random transaction mix
+//
+
+static uint32_t rng_state;
+
+static inline uint32_t rng_next() {
+    // xorshift32
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+static inline uint rng_below(uint n) {
+    return rng_next() % n;
+}
+
+static inline uint transfer_size() {
+    // mostly short register accesses, with some long bursts
+    return rng_below(4) == 0 ? 1 + rng_below(MAX_TRANSFER) : 1 + rng_below(8);
+}
+
+//
+// model
+//
+
+static void model_write(uint8_t address, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t reg = (uint8_t)(address + i);
+        if (reg < READ_ONLY_START) {
+            model.mem[reg] = data[i];
+        }
+    }
+    model.address = (uint8_t)(address + len);
+    model.address_known = true;
+}
+
+static bool model_check(const uint8_t *data, size_t len) {
+    uint8_t address = model.address;
+    model.address = (uint8_t)(address + len);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t reg = (uint8_t)(address + i);
+        if (data[i] != model.mem[reg]) {
+            if (counters.mismatches < 8) {
+                printf("# mismatch at 0x%02X: expected 0x%02X, read 0x%02X\n", reg, model.mem[reg], data[i]);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// slave, on STRESS_SLAVE_CORE
+//
+
+static void setup_slave(const stress_phase_t *phase) {
+    i2c_init(i2c0, phase->baudrate);
+    gpio_set_function(I2C_SLAVE_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_SLAVE_SCL_PIN, GPIO_FUNC_I2C);
+
+    i2c_regmap_config_t config = i2c_regmap_get_default_config(mem, sizeof(mem));
+    config.ranges = ranges;
+    config.num_ranges = count_of(ranges);
+    config.prefill = phase->prefill;
+    i2c_regmap_init(&regmap, &config);
+    i2c_slave_config_t slave_config = phase->fast_mode_plus ? i2c_slave_get_fast_mode_plus_config() : i2c_slave_get_default_config();
+    i2c_regmap_slave_init_with_config(i2c0, I2C_SLAVE_ADDRESS, &regmap, &slave_config);
+}
+
+static void teardown_slave() {
+    i2c_slave_deinit(i2c0);
+}
+
+#if STRESS_SLAVE_CORE
+
+// The slave must be set up and torn down from the core running its ISR. Core 1 does that when
+// asked by master, then goes back to waiting, with the ISR serving the bus.
+static void core1_main() {
+    for (;;) {
+        uint32_t command = multicore_fifo_pop_blocking();
+        if (command < count_of(PHASES)) {
+            setup_slave(&PHASES[command]);
+        } else {
+            teardown_slave();
+        }
+        multicore_fifo_push_blocking(command);
+    }
+}
+
+static void run_on_slave_core(uint32_t command) {
+    multicore_fifo_push_blocking(command);
+    multicore_fifo_pop_blocking();
+}
+
+static void start_phase(uint index) {
+    run_on_slave_core(index);
+}
+
+static void end_phase() {
+    run_on_slave_core(UINT32_MAX);
+}
+
+#else
+
+static void start_phase(uint index) {
+    setup_slave(&PHASES[index]);
+}
+
+static void end_phase() {
+    teardown_slave();
+}
+
+#endif
+
+//
+// master
+//
+
+static bool check_count(int count, size_t expected) {
+    if (count == (int)expected) {
+        return true;
+    }
+    if (count == PICO_ERROR_TIMEOUT) {
+        counters.timeouts++;
+    } else {
+        counters.failures++;
+    }
+    model.address_known = false;
+    return false;
+}
+
+static bool master_write(const uint8_t *src, size_t len, bool nostop) {
+    int count = i2c_write_timeout_us(i2c1, I2C_SLAVE_ADDRESS, src, len, nostop, TIMEOUT_US);
+    return check_count(count, len);
+}
+
+static bool master_read(uint8_t *dst, size_t len, bool nostop) {
+    int count = i2c_read_timeout_us(i2c1, I2C_SLAVE_ADDRESS, dst, len, nostop, TIMEOUT_US);
+    if (!check_count(count, len)) {
+        return false;
+    }
+    if (!model_check(dst, len)) {
+        counters.mismatches++;
+        model.address_known = false;
+    }
+    counters.bytes += len;
+    return true;
+}
+
+static void resync() {
+    // After a failed transfer the slave may have taken part of it, and after a mismatch the model
+    // is wrong. Read the whole map back, rather than guess, and carry on from there.
+    uint8_t buf[1 + MEM_SIZE] = {0};
+    if (i2c_write_timeout_us(i2c1, I2C_SLAVE_ADDRESS, buf, 1, true, TIMEOUT_US) == 1
+        && i2c_read_timeout_us(i2c1, I2C_SLAVE_ADDRESS, buf, MEM_SIZE, false, TIMEOUT_US * 4) == MEM_SIZE) {
+        memcpy(model.mem, buf, MEM_SIZE);
+        model.address = 0;
+        model.address_known = true;
+    }
+}
+
+// One transaction from the mix, ending with Stop or leaving the bus for a Restart.
+static void run_transaction() {
+    uint8_t buf[1 + MAX_TRANSFER];
+    uint8_t address = (uint8_t)rng_next();
+    size_t len = transfer_size();
+    bool nostop = rng_below(2) == 0;
+    uint kind = rng_below(16);
+    if (!model.address_known && kind >= 8 && kind < 12) {
+        kind = 0; // can't continue from an unknown address
+    }
+
+    if (kind < 4) {
+        // write registers
+        buf[0] = address;
+        for (size_t i = 0; i < len; i++) {
+            buf[1 + i] = (uint8_t)rng_next();
+        }
+        if (master_write(buf, 1 + len, nostop)) {
+            model_write(address, buf + 1, len);
+            counters.bytes += len;
+        }
+    } else if (kind < 8) {
+        // random-access read: set the address, then read after a Restart
+        buf[0] = address;
+        if (master_write(buf, 1, true)) {
+            model_write(address, NULL, 0);
+            master_read(buf, len, nostop);
+        }
+    } else if (kind < 12) {
+        // read on from the current address, leaving part of what the slave queued unsent
+        master_read(buf, len, nostop);
+    } else if (kind < 15) {
+        // set the address and Stop, so a staged response is discarded, then read
+        buf[0] = address;
+        if (master_write(buf, 1, false)) {
+            model_write(address, NULL, 0);
+            master_read(buf, len, nostop);
+        }
+    } else {
+        // a device which isn't there must NACK, and leave the slave alone
+        buf[0] = address;
+        int count = i2c_write_timeout_us(i2c1, I2C_ABSENT_ADDRESS, buf, 1, false, TIMEOUT_US);
+        if (count >= 0) {
+            counters.nacks++;
+        }
+    }
+    counters.transactions++;
+    if (!model.address_known) {
+        resync();
+    }
+}
+
+static void report(uint32_t seconds, uint phase_index, const stress_counters_t *last, uint32_t interval_us) {
+    const stress_phase_t *phase = &PHASES[phase_index];
+    i2c_slave_stats_t stats;
+    i2c_slave_get_stats(i2c0, &stats);
+    double interval_s = interval_us / 1e6;
+
+    printf("%lu,%u,%u,%u,%u,%.0f,%.0f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+        (unsigned long)seconds, phase_index, phase->baudrate, phase->fast_mode_plus, phase->prefill,
+        (counters.transactions - last->transactions) / interval_s,
+        (counters.bytes - last->bytes) / interval_s,
+        (unsigned long)counters.transactions, (unsigned long)counters.mismatches,
+        (unsigned long)counters.failures, (unsigned long)counters.timeouts, (unsigned long)counters.nacks,
+        (unsigned long)stats.tx_aborts, (unsigned long)stats.rx_overflows, (unsigned long)stats.tx_prefills,
+        (unsigned long)stats.tx_prefill_misses);
+}
+
+static void setup_master_pins() {
+    gpio_init(I2C_SLAVE_SDA_PIN);
+    gpio_pull_up(I2C_SLAVE_SDA_PIN);
+    gpio_init(I2C_SLAVE_SCL_PIN);
+    gpio_pull_up(I2C_SLAVE_SCL_PIN);
+
+    gpio_init(I2C_MASTER_SDA_PIN);
+    gpio_set_function(I2C_MASTER_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_MASTER_SDA_PIN);
+
+    gpio_init(I2C_MASTER_SCL_PIN);
+    gpio_set_function(I2C_MASTER_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_MASTER_SCL_PIN);
+}
+
+int main() {
+    stdio_init_all();
+    // give the host some time to open the serial connection
+    sleep_ms(2000);
+    puts("\nI2C slave stress test");
+
+    rng_state = STRESS_SEED != 0 ? STRESS_SEED : (uint32_t)time_us_64() | 1;
+    printf("# seed %lu\n", (unsigned long)rng_state);
+    // Rates are over the last report interval, counters are totals since startup.
+    // tx_aborts onwards come from the slave statistics, and restart with each phase.
+    puts("# seconds,phase,baudrate,fast_mode_plus,prefill,transactions_per_s,bytes_per_s,transactions,"
+         "mismatches,failures,timeouts,nacks,tx_aborts,rx_overflows,tx_prefills,tx_prefill_misses");
+
+    setup_master_pins();
+#if STRESS_SLAVE_CORE
+    multicore_launch_core1(core1_main);
+#endif
+
+    // master doesn't know what's in the slave yet
+    memset(mem, 0, sizeof(mem));
+    strncpy((char *)mem + READ_ONLY_START, "pico_i2c_slave", MEM_SIZE - READ_ONLY_START);
+    memcpy(model.mem, mem, MEM_SIZE);
+    model.address = 0;
+    model.address_known = true;
+
+    uint64_t start_us = time_us_64();
+    for (uint phase_index = 0;; phase_index = (phase_index + 1) % count_of(PHASES)) {
+        const stress_phase_t *phase = &PHASES[phase_index];
+        i2c_init(i2c1, phase->baudrate);
+        // the register map survives the slave restart, only the address goes back to 0
+        start_phase(phase_index);
+        model.address = 0;
+
+        uint64_t phase_start_us = time_us_64();
+        uint64_t report_us = phase_start_us;
+        stress_counters_t last = counters;
+        for (;;) {
+            run_transaction();
+            uint64_t now_us = time_us_64();
+            if (now_us - report_us >= STRESS_REPORT_S * 1000000ull) {
+                report((uint32_t)((now_us - start_us) / 1000000u), phase_index, &last, (uint32_t)(now_us - report_us));
+                last = counters;
+                report_us = now_us;
+            }
+            if (now_us - phase_start_us >= STRESS_PHASE_S * 1000000ull) {
+                break;
+            }
+        }
+        end_phase();
+#if STRESS_DURATION_S
+        if (time_us_64() - start_us >= STRESS_DURATION_S * 1000000ull) {
+            break;
+        }
+#endif
+    }
+    bool passed = counters.mismatches == 0 && counters.failures == 0 && counters.timeouts == 0 && counters.nacks == 0;
+    puts(passed ? "# done, no errors" : "# done, with errors");
+    return passed ? 0 : 1;
+}